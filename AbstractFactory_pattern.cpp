@@ -7,10 +7,27 @@ Pros: Can create the objects without knowing its type. Client no need to deal wi
 Cons: The abstract factory class need to know about every abstract product type that created.
       Support new kinds of product is difficult, which involves changing the AbstractFactory class and 
       all it subclasses.
-      Avoid this: TODO?
+      Avoid this: describe each family as a type list (see Family/StaticEnemyFactory below),
+      new product kinds are then added without touching any factory.
 */
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 using namespace std;
 
@@ -45,61 +62,767 @@ class FurryMonster : public Monster {
 class FurrySuperMonster : public SuperMonster {
 };
 
+// Object pools for the products. Every concrete type gets one pool per
+// thread: a free list of fixed-size slots carved from slabs. Slabs are owned
+// by a process-wide list and never handed back to the heap, so a slot can be
+// released on any thread (it simply joins that thread's free list), and a
+// thread that exits donates its free slots to a shared list for reuse.
+// Runs stay whole when released and are kept on free lists per run length,
+// so a batch of the same size reuses them instead of carving a new slab.
+template <typename T>
+class ObjectPool {
+    public:
+        static constexpr size_t kSlabSlots = 1024;
+        static constexpr size_t kAlign = alignof(T) > alignof(void*) ? alignof(T) : alignof(void*);
+        static constexpr size_t kStride =
+            ((sizeof(T) > sizeof(void*) ? sizeof(T) : sizeof(void*)) + kAlign - 1) / kAlign * kAlign;
+        static_assert(kAlign <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "over-aligned products need an aligned slab");
+
+        static ObjectPool& Local() {
+            thread_local ObjectPool pool;
+            return pool;
+        }
+
+        T* Acquire() {
+            void* slot = Pop();
+            if (slot == nullptr) slot = Carve(1);
+            return new (slot) T();
+        }
+
+        // n objects in one contiguous run of slots, kStride bytes apart
+        T* AcquireRun(size_t n) {
+            void* run = n > 1 ? PopRun(n) : n == 1 ? Pop() : nullptr;
+            if (run == nullptr) run = Carve(n);
+            unsigned char* first = static_cast<unsigned char*>(run);
+            for (size_t i = 0; i < n; ++i) new (first + i * kStride) T();
+            return reinterpret_cast<T*>(first);
+        }
+
+        void Release(T* object) {
+            object->~T();
+            Push(object);
+        }
+
+        static void ReleaseOne(void* object) { Local().Release(static_cast<T*>(object)); }
+
+        static void ReleaseRun(void* first, size_t n) {
+            ObjectPool& pool = Local();
+            for (size_t i = 0; i < n; ++i)
+                At(first, i)->~T();
+            if (n > 1)
+                pool.PushRun(first, n);
+            else if (n == 1)
+                pool.Push(first);
+        }
+
+        static T* At(void* first, size_t i) {
+            return reinterpret_cast<T*>(static_cast<unsigned char*>(first) + i * kStride);
+        }
+
+        // Slabs allocated so far by all threads; memory is only returned at exit
+        static size_t SlabCount() {
+            Shared& shared = Global();
+            lock_guard<mutex> guard(shared.lock);
+            return shared.slabs.size();
+        }
+
+    private:
+        // A thread keeps at most this many freed slots per list; past it the
+        // list goes to Shared, so slots freed on one thread and allocated on
+        // another (wave chunks built by workers, dropped on main) come back
+        static constexpr size_t kFlushSlots = 2 * kSlabSlots;
+
+        struct FreeSlot { FreeSlot* next; };
+
+        struct FreeList {
+            FreeSlot* head = nullptr;
+            FreeSlot* tail = nullptr;
+            size_t count = 0;
+
+            void Push(void* slot) {
+                FreeSlot* node = static_cast<FreeSlot*>(slot);
+                node->next = head;
+                if (head == nullptr) tail = node;
+                head = node;
+                ++count;
+            }
+
+            void* Pop() {
+                FreeSlot* node = head;
+                if (node == nullptr) return nullptr;
+                head = node->next;
+                if (head == nullptr) tail = nullptr;
+                --count;
+                return node;
+            }
+
+            // Moves the whole list in front of `to`
+            void SpliceInto(FreeList& to) {
+                if (head == nullptr) return;
+                tail->next = to.head;
+                if (to.head == nullptr) to.tail = tail;
+                to.head = head;
+                to.count += count;
+                *this = FreeList();
+            }
+
+            // Moves up to `limit` entries from the front of `from` into
+            // this list, which must be empty. Bounded so one thread can't
+            // take every free slot while others carve new slabs.
+            void TakeFrom(FreeList& from, size_t limit) {
+                if (limit >= from.count) {
+                    from.SpliceInto(*this);
+                    return;
+                }
+                FreeSlot* last = from.head;
+                for (size_t i = 1; i < limit; ++i) last = last->next;
+                head = from.head;
+                tail = last;
+                count = limit;
+                from.head = last->next;
+                from.count -= limit;
+                last->next = nullptr;
+            }
+        };
+
+        struct Shared {
+            mutex lock;
+            vector<unique_ptr<unsigned char[]>> slabs;
+            FreeList free;
+            unordered_map<size_t, FreeList> runs;  // run length -> free runs
+        };
+
+        static Shared& Global() {
+            static Shared shared;
+            return shared;
+        }
+
+        ObjectPool() { Global(); } // make sure the shared state outlives every pool
+
+        ~ObjectPool() {
+            // Hand the unused tail and the free lists over to other threads
+            while (m_cursor != m_end) {
+                m_free.Push(m_cursor);
+                m_cursor += kStride;
+            }
+            Shared& shared = Global();
+            lock_guard<mutex> guard(shared.lock);
+            for (auto& runs : m_runs)
+                runs.second.SpliceInto(shared.runs[runs.first]);
+            m_free.SpliceInto(shared.free);
+        }
+
+        void Push(void* slot) {
+            m_free.Push(slot);
+            if (m_free.count > kFlushSlots) {
+                Shared& shared = Global();
+                lock_guard<mutex> guard(shared.lock);
+                m_free.SpliceInto(shared.free);
+            }
+        }
+
+        void* Pop() {
+            if (m_free.head == nullptr) {
+                Shared& shared = Global();
+                lock_guard<mutex> guard(shared.lock);
+                m_free.TakeFrom(shared.free, kSlabSlots);
+            }
+            return m_free.Pop();
+        }
+
+        // A free run of exactly n slots, linked through its first slot
+        void PushRun(void* first, size_t n) {
+            FreeList& runs = m_runs[n];
+            runs.Push(first);
+            if (runs.count * n > kFlushSlots) {
+                Shared& shared = Global();
+                lock_guard<mutex> guard(shared.lock);
+                runs.SpliceInto(shared.runs[n]);
+            }
+        }
+
+        void* PopRun(size_t n) {
+            FreeList& runs = m_runs[n];
+            if (runs.head == nullptr) {
+                Shared& shared = Global();
+                lock_guard<mutex> guard(shared.lock);
+                auto found = shared.runs.find(n);
+                if (found != shared.runs.end())
+                    runs.TakeFrom(found->second, n < kSlabSlots ? kSlabSlots / n : 1);
+            }
+            return runs.Pop();
+        }
+
+        // n contiguous slots from the current slab, starting a new slab if needed
+        void* Carve(size_t n) {
+            if (static_cast<size_t>(m_end - m_cursor) < n * kStride) {
+                while (m_cursor != m_end) {
+                    Push(m_cursor);
+                    m_cursor += kStride;
+                }
+                size_t slots = n > kSlabSlots ? n : kSlabSlots;
+                unique_ptr<unsigned char[]> slab(new unsigned char[slots * kStride]);
+                m_cursor = slab.get();
+                m_end = m_cursor + slots * kStride;
+                Shared& shared = Global();
+                lock_guard<mutex> guard(shared.lock);
+                shared.slabs.push_back(move(slab));
+            }
+            void* first = m_cursor;
+            m_cursor += n * kStride;
+            return first;
+        }
+
+        FreeList m_free;
+        unordered_map<size_t, FreeList> m_runs;
+        unsigned char* m_cursor = nullptr;
+        unsigned char* m_end = nullptr;
+};
+
+// Owning handle to one pooled product; gives the slot back when destroyed
+template <typename Base>
+class PoolHandle {
+    public:
+        PoolHandle() = default;
+        template <typename T>
+        explicit PoolHandle(T* object)
+        : m_ptr(object), m_object(object), m_release(&ObjectPool<T>::ReleaseOne) {}
+
+        PoolHandle(PoolHandle&& other) noexcept { *this = move(other); }
+        PoolHandle& operator=(PoolHandle&& other) noexcept {
+            if (this != &other) {
+                Reset();
+                swap(m_ptr, other.m_ptr);
+                swap(m_object, other.m_object);
+                swap(m_release, other.m_release);
+            }
+            return *this;
+        }
+        ~PoolHandle() { Reset(); }
+
+        Base* get() const { return m_ptr; }
+        Base* operator->() const { return m_ptr; }
+        Base& operator*() const { return *m_ptr; }
+        explicit operator bool() const { return m_ptr != nullptr; }
+
+        void Reset() {
+            if (m_ptr != nullptr) m_release(m_object);
+            m_ptr = nullptr;
+        }
+
+    private:
+        Base* m_ptr = nullptr;
+        void* m_object = nullptr;
+        void (*m_release)(void*) = nullptr;
+};
+
+// Owning handle to a contiguous run of pooled products of one concrete type
+template <typename Base>
+class PoolBatch {
+    public:
+        PoolBatch() = default;
+        template <typename T>
+        PoolBatch(T* first, size_t count)
+        : m_first(first), m_count(count),
+          m_at([](void* p, size_t i) -> Base* { return ObjectPool<T>::At(p, i); }),
+          m_release(&ObjectPool<T>::ReleaseRun) {}
+
+        PoolBatch(PoolBatch&& other) noexcept { *this = move(other); }
+        PoolBatch& operator=(PoolBatch&& other) noexcept {
+            if (this != &other) {
+                Reset();
+                swap(m_first, other.m_first);
+                swap(m_count, other.m_count);
+                swap(m_at, other.m_at);
+                swap(m_release, other.m_release);
+            }
+            return *this;
+        }
+        ~PoolBatch() { Reset(); }
+
+        size_t size() const { return m_count; }
+        Base& operator[](size_t i) const { return *m_at(m_first, i); }
+
+        void Reset() {
+            if (m_first != nullptr) m_release(m_first, m_count);
+            m_first = nullptr;
+            m_count = 0;
+        }
+
+    private:
+        void* m_first = nullptr;
+        size_t m_count = 0;
+        Base* (*m_at)(void*, size_t) = nullptr;
+        void (*m_release)(void*, size_t) = nullptr;
+};
+
+template <typename T, typename Base>
+PoolHandle<Base> MakePooled() {
+    return PoolHandle<Base>(ObjectPool<T>::Local().Acquire());
+}
+
+template <typename T, typename Base>
+PoolBatch<Base> MakePooledBatch(size_t n) {
+    return PoolBatch<Base>(ObjectPool<T>::Local().AcquireRun(n), n);
+}
+
 // Abstract factory base class
 class AbstractEnemyFactory {
     public:
-        virtual Soldier* MakeSoldier() const = 0;
-        virtual Monster* MakeMonster() const = 0;
-        virtual SuperMonster* MakeSuperMonster() const = 0;
+        virtual ~AbstractEnemyFactory() = default;
+        virtual PoolHandle<Soldier> MakeSoldier() const = 0;
+        virtual PoolHandle<Monster> MakeMonster() const = 0;
+        virtual PoolHandle<SuperMonster> MakeSuperMonster() const = 0;
+        virtual PoolBatch<Soldier> MakeSoldiers(size_t n) const = 0;
+        virtual PoolBatch<Monster> MakeMonsters(size_t n) const = 0;
+        virtual PoolBatch<SuperMonster> MakeSuperMonsters(size_t n) const = 0;
 };
 
 // Concrete Factory classes
 class EasyLevelEnemyFactory : public AbstractEnemyFactory {
     public:
-        Soldier* MakeSoldier() const override { 
-            return new SillySoldier(); 
+        PoolHandle<Soldier> MakeSoldier() const override { 
+            return MakePooled<SillySoldier, Soldier>(); 
+        }
+        PoolHandle<Monster> MakeMonster() const override { 
+            return MakePooled<SillyMonster, Monster>(); 
+        }
+        PoolHandle<SuperMonster> MakeSuperMonster() const override { 
+            return MakePooled<SillySuperMonster, SuperMonster>(); 
         }
-        Monster* MakeMonster() const override { 
-            return new SillyMonster(); 
+        PoolBatch<Soldier> MakeSoldiers(size_t n) const override {
+            return MakePooledBatch<SillySoldier, Soldier>(n);
         }
-        SuperMonster* MakeSuperMonster() const override { 
-            return new SillySuperMonster(); 
+        PoolBatch<Monster> MakeMonsters(size_t n) const override {
+            return MakePooledBatch<SillyMonster, Monster>(n);
+        }
+        PoolBatch<SuperMonster> MakeSuperMonsters(size_t n) const override {
+            return MakePooledBatch<SillySuperMonster, SuperMonster>(n);
         }
 };
 
 class DieHardLevelEnemyFactory : public AbstractEnemyFactory {
     public:
-        Soldier* MakeSoldier() const override { 
-            return new FurrySoldier(); 
+        PoolHandle<Soldier> MakeSoldier() const override { 
+            return MakePooled<FurrySoldier, Soldier>(); 
+        }
+        PoolHandle<Monster> MakeMonster() const override { 
+            return MakePooled<FurryMonster, Monster>(); 
+        }
+        PoolHandle<SuperMonster> MakeSuperMonster() const override { 
+            return MakePooled<FurrySuperMonster, SuperMonster>(); 
+        }
+        PoolBatch<Soldier> MakeSoldiers(size_t n) const override {
+            return MakePooledBatch<FurrySoldier, Soldier>(n);
+        }
+        PoolBatch<Monster> MakeMonsters(size_t n) const override {
+            return MakePooledBatch<FurryMonster, Monster>(n);
+        }
+        PoolBatch<SuperMonster> MakeSuperMonsters(size_t n) const override {
+            return MakePooledBatch<FurrySuperMonster, SuperMonster>(n);
+        }
+};
+
+// Compile-time product families. A family is a type list of concrete
+// products; asking it for an abstract product picks the member derived from
+// it, so creation is a direct (inlinable) call with no virtual dispatch.
+// Adding a product kind only means adding its classes and listing them in
+// the families: no factory class has to change.
+template <typename... Products>
+struct Family {};
+
+using EasyFamily = Family<SillySoldier, SillyMonster, SillySuperMonster>;
+using DieHardFamily = Family<FurrySoldier, FurryMonster, FurrySuperMonster>;
+
+template <typename Base, typename... Products>
+struct FindProduct;
+
+template <typename Base, typename First, typename... Rest>
+struct FindProduct<Base, First, Rest...> {
+    using type = conditional_t<is_base_of_v<Base, First>, First,
+                               typename FindProduct<Base, Rest...>::type>;
+};
+
+template <typename Base>
+struct FindProduct<Base> {
+    using type = void; // family has no product of this kind
+};
+
+template <typename Fam, typename Base>
+struct ProductOf;
+
+template <typename... Products, typename Base>
+struct ProductOf<Family<Products...>, Base> {
+    using type = typename FindProduct<Base, Products...>::type;
+    static_assert(!is_void_v<type>, "family has no product derived from this base");
+};
+
+template <typename Fam>
+class StaticEnemyFactory {
+    public:
+        template <typename Base>
+        using Product = typename ProductOf<Fam, Base>::type;
+
+        template <typename Base>
+        static PoolHandle<Base> Make() {
+            return MakePooled<Product<Base>, Base>();
+        }
+
+        template <typename Base>
+        static PoolBatch<Base> MakeBatch(size_t n) {
+            return MakePooledBatch<Product<Base>, Base>(n);
+        }
+};
+
+// The only runtime decision: pick the family once, then run fn (typically
+// a whole spawn loop) against the statically typed factory
+template <typename Fn>
+decltype(auto) WithLevelFactory(Level lev, Fn&& fn) {
+    if(lev == Level::EASY)
+        return fn(StaticEnemyFactory<EasyFamily>{});
+    return fn(StaticEnemyFactory<DieHardFamily>{});
+}
+
+// Data-oriented storage for simulation ticks. Each concrete enemy type is an
+// archetype holding its fields as parallel arrays (structure of arrays), so
+// an update walks a few dense float columns that the compiler can vectorize
+// instead of chasing pointers to heap objects.
+template <typename T>
+struct EnemyStats {
+    static constexpr float kMaxHealth = 100.0f;
+    static constexpr float kRegen = is_base_of_v<SuperMonster, T> ? 5.0f : 0.0f; // health per second
+};
+
+// Stable reference to an entity of archetype T; survives other removals
+template <typename T>
+struct Entity {
+    uint32_t index;
+    uint32_t generation;
+};
+
+template <typename T>
+class Archetype {
+    public:
+        Entity<T> Create(float x, float y, float vx, float vy) {
+            uint32_t slot;
+            if(!m_freeSlots.empty()) {
+                slot = m_freeSlots.back();
+                m_freeSlots.pop_back();
+            } else {
+                slot = static_cast<uint32_t>(m_denseOf.size());
+                m_denseOf.push_back(0);
+                m_generation.push_back(0);
+            }
+            m_denseOf[slot] = static_cast<uint32_t>(m_x.size());
+            m_slotOf.push_back(slot);
+            m_x.push_back(x);
+            m_y.push_back(y);
+            m_vx.push_back(vx);
+            m_vy.push_back(vy);
+            m_health.push_back(EnemyStats<T>::kMaxHealth);
+            return Entity<T>{slot, m_generation[slot]};
+        }
+
+        bool Alive(Entity<T> e) const {
+            return e.index < m_generation.size() && m_generation[e.index] == e.generation;
+        }
+
+        // Swap-remove: the last entity moves into the hole, its handle stays valid
+        void Destroy(Entity<T> e) {
+            if(!Alive(e)) return;
+            uint32_t dense = m_denseOf[e.index];
+            uint32_t last = static_cast<uint32_t>(m_x.size() - 1);
+            m_x[dense] = m_x[last];
+            m_y[dense] = m_y[last];
+            m_vx[dense] = m_vx[last];
+            m_vy[dense] = m_vy[last];
+            m_health[dense] = m_health[last];
+            m_slotOf[dense] = m_slotOf[last];
+            m_denseOf[m_slotOf[dense]] = dense;
+            m_x.pop_back();
+            m_y.pop_back();
+            m_vx.pop_back();
+            m_vy.pop_back();
+            m_health.pop_back();
+            m_slotOf.pop_back();
+            ++m_generation[e.index];
+            m_freeSlots.push_back(e.index);
+        }
+
+        size_t Size() const { return m_x.size(); }
+        float X(Entity<T> e) const { return m_x[m_denseOf[e.index]]; }
+        float Y(Entity<T> e) const { return m_y[m_denseOf[e.index]]; }
+        float Health(Entity<T> e) const { return m_health[m_denseOf[e.index]]; }
+        void Damage(Entity<T> e, float amount) { m_health[m_denseOf[e.index]] -= amount; }
+
+        // Straight-line loop over raw columns with no aliasing, so it vectorizes
+        void Update(float dt) {
+            const size_t n = m_x.size();
+            float* __restrict x = m_x.data();
+            float* __restrict y = m_y.data();
+            const float* __restrict vx = m_vx.data();
+            const float* __restrict vy = m_vy.data();
+            float* __restrict health = m_health.data();
+            const float regen = EnemyStats<T>::kRegen * dt;
+            const float max_health = EnemyStats<T>::kMaxHealth;
+            for(size_t i = 0; i < n; ++i) {
+                x[i] += vx[i] * dt;
+                y[i] += vy[i] * dt;
+                float h = health[i] + regen;
+                health[i] = h < max_health ? h : max_health;
+            }
+        }
+
+    private:
+        vector<float> m_x, m_y, m_vx, m_vy, m_health; // dense columns
+        vector<uint32_t> m_slotOf;     // dense index -> handle slot
+        vector<uint32_t> m_denseOf;    // handle slot -> dense index
+        vector<uint32_t> m_generation; // bumped when a slot is freed
+        vector<uint32_t> m_freeSlots;
+};
+
+template <typename... Types>
+class ArchetypeStore {
+    public:
+        template <typename T>
+        Archetype<T>& Get() { return get<Archetype<T>>(m_archetypes); }
+
+        size_t Size() const {
+            return apply([](const auto&... a) { return (a.Size() + ... + size_t{0}); }, m_archetypes);
+        }
+
+        void Update(float dt) {
+            apply([dt](auto&... a) { (a.Update(dt), ...); }, m_archetypes);
+        }
+
+    private:
+        tuple<Archetype<Types>...> m_archetypes;
+};
+
+using EnemyStore = ArchetypeStore<SillySoldier, SillyMonster, SillySuperMonster,
+                                  FurrySoldier, FurryMonster, FurrySuperMonster>;
+
+// Fixed set of worker threads. Run(n, task) deals task indices round-robin
+// onto per-worker queues; a worker takes from the front of its own queue and
+// steals from the back of the others once it runs dry.
+class WorkStealingPool {
+    public:
+        explicit WorkStealingPool(size_t threads) : m_queues(threads == 0 ? 1 : threads) {
+            for(size_t w = 0; w < m_queues.size(); ++w)
+                m_workers.emplace_back(&WorkStealingPool::Work, this, w);
+        }
+
+        ~WorkStealingPool() {
+            {
+                lock_guard<mutex> guard(m_lock);
+                m_stop = true;
+            }
+            m_wake.notify_all();
+            for(auto& worker : m_workers)
+                worker.join();
+        }
+
+        size_t Size() const { return m_workers.size(); }
+
+        /* Runs task(0..n-1) on the workers and waits for all of them. A worker still looking for
+           work from the previous Run may pick up these items, so each item carries its own task
+           and m_pending is set before any item is visible. Concurrent Runs take turns. */
+        void Run(size_t n, const function<void(size_t)>& task) {
+            if(n == 0) return;
+            lock_guard<mutex> running(m_running);
+            {
+                lock_guard<mutex> guard(m_lock);
+                m_pending = n;
+            }
+            for(size_t i = 0; i < n; ++i) {
+                Queue& queue = m_queues[i % m_queues.size()];
+                lock_guard<mutex> guard(queue.lock);
+                queue.items.push_back(Item{&task, i});
+            }
+            {
+                lock_guard<mutex> guard(m_lock);
+                ++m_generation;
+            }
+            m_wake.notify_all();
+            unique_lock<mutex> guard(m_lock);
+            m_done.wait(guard, [this] { return m_pending == 0; });
+        }
+
+    private:
+        struct Item {
+            const function<void(size_t)>* task;
+            size_t index;
+        };
+
+        struct Queue {
+            mutex lock;
+            deque<Item> items;
+        };
+
+        bool Take(size_t self, Item& item) {
+            for(size_t k = 0; k < m_queues.size(); ++k) {
+                Queue& queue = m_queues[(self + k) % m_queues.size()];
+                lock_guard<mutex> guard(queue.lock);
+                if(queue.items.empty()) continue;
+                if(k == 0) {
+                    item = queue.items.front();
+                    queue.items.pop_front();
+                } else {
+                    item = queue.items.back();
+                    queue.items.pop_back();
+                }
+                return true;
+            }
+            return false;
+        }
+
+        void Work(size_t self) {
+            size_t seen = 0;
+            for(;;) {
+                {
+                    unique_lock<mutex> guard(m_lock);
+                    m_wake.wait(guard, [&] { return m_stop || m_generation != seen; });
+                    if(m_stop) return;
+                    seen = m_generation;
+                }
+                Item item;
+                while(Take(self, item)) {
+                    (*item.task)(item.index);
+                    lock_guard<mutex> guard(m_lock);
+                    if(--m_pending == 0) m_done.notify_all();
+                }
+            }
+        }
+
+        vector<Queue> m_queues;
+        vector<thread> m_workers;
+        mutex m_running;  // one Run at a time
+        mutex m_lock;
+        condition_variable m_wake;
+        condition_variable m_done;
+        size_t m_pending = 0;
+        size_t m_generation = 0;
+        bool m_stop = false;
+};
+
+struct WaveSpec {
+    size_t soldiers = 0;
+    size_t monsters = 0;
+    size_t super_monsters = 0;
+};
+
+// A spawned wave: per type, the contiguous chunks built by the workers.
+// Chunks are moved in as handles, so no enemy is copied when merging.
+class Wave {
+    public:
+        vector<PoolBatch<Soldier>> soldiers;
+        vector<PoolBatch<Monster>> monsters;
+        vector<PoolBatch<SuperMonster>> super_monsters;
+
+        size_t Size() const {
+            return Count(soldiers) + Count(monsters) + Count(super_monsters);
         }
-        Monster* MakeMonster() const override { 
-            return new FurryMonster(); 
+
+        // fn is called with Soldier&, Monster& and SuperMonster& in turn
+        template <typename Fn>
+        void ForEach(Fn&& fn) const {
+            Visit(soldiers, fn);
+            Visit(monsters, fn);
+            Visit(super_monsters, fn);
+        }
+
+    private:
+        template <typename Base>
+        static size_t Count(const vector<PoolBatch<Base>>& chunks) {
+            size_t total = 0;
+            for(const auto& chunk : chunks) total += chunk.size();
+            return total;
         }
-        SuperMonster* MakeSuperMonster() const override { 
-            return new FurrySuperMonster(); 
+
+        template <typename Base, typename Fn>
+        static void Visit(const vector<PoolBatch<Base>>& chunks, Fn& fn) {
+            for(const auto& chunk : chunks)
+                for(size_t i = 0; i < chunk.size(); ++i)
+                    fn(chunk[i]);
         }
 };
 
 class GameApp {
     public:
+        // Waves are built on `workers` threads, by default one per core
+        explicit GameApp(size_t workers = 0)
+        : m_workerCount(workers != 0 ? workers : max(1u, thread::hardware_concurrency())) {}
+
         void  SelectLevel(Level lev) {
+            m_level = lev;
             if(lev == Level::EASY) {
-                pFactory = new EasyLevelEnemyFactory();
+                pFactory = make_unique<EasyLevelEnemyFactory>();
             }else {
-                pFactory = new DieHardLevelEnemyFactory();
+                pFactory = make_unique<DieHardLevelEnemyFactory>();
             }
         }
         
+        // Enemies go back to their pools when the handles are dropped
         void CreateEnemy() const {
             if(pFactory != nullptr) {
-                pFactory->MakeSoldier();
-                pFactory->MakeMonster();
-                pFactory->MakeSuperMonster();
+                PoolHandle<Soldier> soldier = pFactory->MakeSoldier();
+                PoolHandle<Monster> monster = pFactory->MakeMonster();
+                PoolHandle<SuperMonster> super_monster = pFactory->MakeSuperMonster();
             }
         }
+
+        // Same as CreateEnemy, repeated: the level switch is taken once and
+        // every iteration creates enemies through direct calls
+        void CreateEnemies(size_t count) const {
+            WithLevelFactory(m_level, [count](auto factory) {
+                using Factory = decltype(factory);
+                for(size_t i = 0; i < count; ++i) {
+                    PoolHandle<Soldier> soldier = Factory::template Make<Soldier>();
+                    PoolHandle<Monster> monster = Factory::template Make<Monster>();
+                    PoolHandle<SuperMonster> super_monster = Factory::template Make<SuperMonster>();
+                }
+            });
+        }
+        
+        // Builds a large wave in parallel. Each type is cut into fixed-size
+        // chunks; every chunk is one task that fills its own pre-reserved
+        // entry of the wave, so workers never share output.
+        Wave SpawnWave(const WaveSpec& spec) {
+            if(!m_workers)
+                m_workers = make_unique<WorkStealingPool>(m_workerCount);
+
+            auto chunks = [](size_t count) { return (count + kChunk - 1) / kChunk; };
+            auto chunk_size = [](size_t count, size_t k) { return min(kChunk, count - k * kChunk); };
+            Wave wave;
+            wave.soldiers.resize(chunks(spec.soldiers));
+            wave.monsters.resize(chunks(spec.monsters));
+            wave.super_monsters.resize(chunks(spec.super_monsters));
+            const size_t first_monster = wave.soldiers.size();
+            const size_t first_super = first_monster + wave.monsters.size();
+
+            WithLevelFactory(m_level, [&](auto factory) {
+                using Factory = decltype(factory);
+                m_workers->Run(first_super + wave.super_monsters.size(), [&](size_t task) {
+                    if(task < first_monster) {
+                        wave.soldiers[task] = Factory::template MakeBatch<Soldier>(chunk_size(spec.soldiers, task));
+                    } else if(task < first_super) {
+                        size_t k = task - first_monster;
+                        wave.monsters[k] = Factory::template MakeBatch<Monster>(chunk_size(spec.monsters, k));
+                    } else {
+                        size_t k = task - first_super;
+                        wave.super_monsters[k] = Factory::template MakeBatch<SuperMonster>(chunk_size(spec.super_monsters, k));
+                    }
+                });
+            });
+            return wave;
+        }
         
     private:
-        AbstractEnemyFactory* pFactory;
+        unique_ptr<AbstractEnemyFactory> pFactory;
+        Level m_level = Level::EASY;
+        size_t m_workerCount;
+        unique_ptr<WorkStealingPool> m_workers;
+        static constexpr size_t kChunk = 16384; // enemies per wave task
 };
 
 int main() {
@@ -107,6 +830,153 @@ int main() {
     GameApp app;
     app.SelectLevel(Level::EASY);
     app.CreateEnemy();
+    app.SelectLevel(Level::HARD);
+    app.CreateEnemies(1000);
+
+    WaveSpec spec;
+    spec.soldiers = 600000;
+    spec.monsters = 300000;
+    spec.super_monsters = 100000;
+    Wave wave = app.SpawnWave(spec);
+    cout << "wave of " << wave.Size() << " enemies spawned\n";
+
+    // Waves are built on the pool workers and dropped here, so every chunk
+    // is freed on another thread than the one that carved it. Freed chunks
+    // must flow back to the workers instead of piling up on this thread.
+    auto slabs = [] {
+        return ObjectPool<FurrySoldier>::SlabCount() + ObjectPool<FurryMonster>::SlabCount() +
+               ObjectPool<FurrySuperMonster>::SlabCount();
+    };
+    size_t settled = 0;
+    for(int round = 0; round < 30; ++round) {
+        Wave again = app.SpawnWave(spec);
+        if(round == 0) settled = slabs();
+    }
+    if(slabs() > 2 * settled) {
+        cout << "slab count kept growing: " << settled << " -> " << slabs() << "\n";
+        return 1;
+    }
+    cout << "30 waves spawned and despawned in " << slabs() << " slabs\n";
+
+    // Simulation state kept per archetype in structure-of-arrays form
+    EnemyStore store;
+    auto& monsters = store.Get<FurryMonster>();
+    for(int i = 0; i < 1000; ++i)
+        monsters.Create(0.0f, 0.0f, 1.0f, 0.5f);
+    Entity<FurryMonster> boss = monsters.Create(10.0f, 10.0f, 0.0f, 0.0f);
+    monsters.Destroy(Entity<FurryMonster>{0, 0});
+    store.Update(0.016f);
+    cout << store.Size() << " enemies simulated, boss at x=" << monsters.X(boss) << "\n";
+
+    // A whole wave of soldiers in one contiguous run, released together
+    EasyLevelEnemyFactory factory;
+    PoolBatch<Soldier> soldiers = factory.MakeSoldiers(5000);
+
+    // Measurements below are sized to keep the demo quick
+    auto nanos_per = [](size_t ops, auto&& body) {
+        auto start = chrono::steady_clock::now();
+        body();
+        return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / ops;
+    };
+
+    // Spawn/despawn cycles: 1024 enemies alive at a time, then all dropped
+    const size_t alive = 1024, rounds = 2000;
+    vector<PoolHandle<Soldier>> pooled(alive);
+    vector<SillySoldier*> raw(alive);
+    vector<unique_ptr<SillySoldier>> owned(alive);
+    double pool_ns = nanos_per(alive * rounds, [&] {
+        for(size_t r = 0; r < rounds; ++r) {
+            for(auto& handle : pooled) handle = factory.MakeSoldier();
+            for(auto& handle : pooled) handle.Reset();
+        }
+    });
+    double new_ns = nanos_per(alive * rounds, [&] {
+        for(size_t r = 0; r < rounds; ++r) {
+            for(auto& ptr : raw) ptr = new SillySoldier();
+            for(auto& ptr : raw) delete ptr;
+        }
+    });
+    double unique_ns = nanos_per(alive * rounds, [&] {
+        for(size_t r = 0; r < rounds; ++r) {
+            for(auto& ptr : owned) ptr = make_unique<SillySoldier>();
+            for(auto& ptr : owned) ptr.reset();
+        }
+    });
+    cout << "million spawn/despawn cycles per second: pool " << 1e3 / pool_ns
+         << ", new/delete " << 1e3 / new_ns << ", make_unique " << 1e3 / unique_ns << "\n";
+
+    // One soldier, monster and super monster per iteration, created through
+    // the virtual factory and through the family picked once up front
+    volatile bool hard = true;  // keeps the compiler from devirtualizing
+    unique_ptr<AbstractEnemyFactory> level;
+    if(hard) level = make_unique<DieHardLevelEnemyFactory>();
+    else level = make_unique<EasyLevelEnemyFactory>();
+    const size_t spawns = 1000000;
+    double virtual_ns = nanos_per(3 * spawns, [&] {
+        for(size_t i = 0; i < spawns; ++i) {
+            PoolHandle<Soldier> soldier = level->MakeSoldier();
+            PoolHandle<Monster> monster = level->MakeMonster();
+            PoolHandle<SuperMonster> super_monster = level->MakeSuperMonster();
+        }
+    });
+    double static_ns = nanos_per(3 * spawns, [&] {
+        WithLevelFactory(hard ? Level::HARD : Level::EASY, [&](auto family) {
+            using Factory = decltype(family);
+            for(size_t i = 0; i < spawns; ++i) {
+                PoolHandle<Soldier> soldier = Factory::template Make<Soldier>();
+                PoolHandle<Monster> monster = Factory::template Make<Monster>();
+                PoolHandle<SuperMonster> super_monster = Factory::template Make<SuperMonster>();
+            }
+        });
+    });
+    cout << "ns per spawn: virtual factory " << virtual_ns << ", static family " << static_ns << "\n";
+
+    // Build time of the 1M enemy wave on 1 to N workers: the first wave
+    // carves fresh slabs, later ones reuse the runs the previous wave freed.
+    // Efficiency is the speedup over one worker divided by the worker count.
+    double one_worker_ms = 0;
+    for(size_t workers = 1; workers <= max(1u, thread::hardware_concurrency()); workers *= 2) {
+        GameApp builder(workers);
+        builder.SelectLevel(Level::HARD);
+        double cold_ms = nanos_per(1000000, [&] { Wave built = builder.SpawnWave(spec); });
+        double warm_ms = nanos_per(10 * 1000000, [&] {
+            for(int i = 0; i < 10; ++i) Wave built = builder.SpawnWave(spec);
+        });
+        if(workers == 1) one_worker_ms = warm_ms;
+        cout << workers << " workers: first wave " << cold_ms << " ms, next waves " << warm_ms
+             << " ms, efficiency " << one_worker_ms / (warm_ms * workers) << "\n";
+    }
+
+    // Per-tick update of 1M monsters: archetype columns against the same
+    // fields in heap objects updated through a virtual call, visited in
+    // allocation-independent order as a long-running game would see them
+    struct HeapEnemy {
+        float x = 0, y = 0, vx = 1.0f, vy = 0.5f, health = 50.0f;
+        virtual ~HeapEnemy() = default;
+        virtual void Update(float dt) {
+            x += vx * dt;
+            y += vy * dt;
+            health = min(health + EnemyStats<FurryMonster>::kRegen * dt, EnemyStats<FurryMonster>::kMaxHealth);
+        }
+    };
+    const size_t simulated = 1000000;
+    const int ticks = 20;
+    EnemyStore columns;
+    vector<unique_ptr<HeapEnemy>> objects;
+    for(size_t i = 0; i < simulated; ++i) {
+        columns.Get<FurryMonster>().Create(0.0f, 0.0f, 1.0f, 0.5f);
+        objects.push_back(make_unique<HeapEnemy>());
+    }
+    shuffle(objects.begin(), objects.end(), mt19937{42});
+    double column_ns = nanos_per(simulated * ticks, [&] {
+        for(int t = 0; t < ticks; ++t) columns.Update(0.016f);
+    });
+    double object_ns = nanos_per(simulated * ticks, [&] {
+        for(int t = 0; t < ticks; ++t)
+            for(auto& enemy : objects) enemy->Update(0.016f);
+    });
+    cout << "million enemies updated per second: archetype " << 1e3 / column_ns
+         << ", heap objects " << 1e3 / object_ns << "\n";
 
     return 0; 
 }
@@ -0,0 +1,266 @@
+/* Asynchronous logging sink shared by the pattern examples.
+Writing to std::cout with std::endl flushes on every line, which costs far more than the
+operation being logged. Here a log call only copies its arguments into a fixed-size binary
+record in a per-thread ring (single producer, single consumer). A background thread drains
+all rings, formats the records and writes them out in large batches. A thread's ring is handed
+back when the thread exits and reused by the next thread that logs, once it has drained.
+
+Usage: AsyncLogger::Instance().Log("buying ", sticker, " with price: ", price);
+       Parts are concatenated like an ostream chain and a newline is appended.
+       const char* parts must be string literals: only the pointer is stored.
+       std::string parts are copied, truncated to fit the record.
+*/
+
+#ifndef ASYNC_LOGGER_H
+#define ASYNC_LOGGER_H
+
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class AsyncLogger {
+ public:
+  static AsyncLogger &Instance() {
+    static AsyncLogger logger(stdout);
+    return logger;
+  }
+
+  explicit AsyncLogger(FILE *out) : m_out(out) {
+    m_writer = std::thread(&AsyncLogger::Run, this);
+  }
+
+  ~AsyncLogger() {
+    m_stop.store(true, std::memory_order_release);
+    m_writer.join();
+  }
+
+  AsyncLogger(const AsyncLogger &) = delete;
+  AsyncLogger &operator=(const AsyncLogger &) = delete;
+
+  template <typename... Parts>
+  void Log(const Parts &...parts) {
+    using Format = Formatter<Stored<Parts>...>;
+    static_assert(Format::kFixedBytes <= kPayload, "too many parts for one log record");
+    Ring &ring = LocalRing();
+    size_t tail = ring.tail.load(std::memory_order_relaxed);
+    while (tail - ring.head.load(std::memory_order_acquire) == Ring::kCapacity)
+      std::this_thread::yield();  // ring full: wait for the writer thread
+    Record &record = ring.records[tail & (Ring::kCapacity - 1)];
+    record.format = &Format::Format;
+    unsigned char *payload = record.payload;
+    (Format::template Encode<Stored<Parts>>(payload, parts), ...);
+    ring.tail.store(tail + 1, std::memory_order_release);
+  }
+
+  // Blocks until everything logged so far, by any thread, has been written
+  void Flush() {
+    std::vector<std::pair<Ring *, size_t>> targets;
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      for (auto &ring : m_rings)
+        targets.emplace_back(ring.get(), ring->tail.load(std::memory_order_acquire));
+    }
+    for (auto &target : targets)
+      while (target.first->head.load(std::memory_order_acquire) < target.second)
+        std::this_thread::yield();
+    uint64_t pass = m_passes.load(std::memory_order_acquire);
+    while (m_passes.load(std::memory_order_acquire) == pass)
+      std::this_thread::yield();
+  }
+
+ private:
+  static constexpr size_t kPayload = 120;
+
+  struct Record {
+    void (*format)(const unsigned char *, std::string &);
+    unsigned char payload[kPayload];
+  };
+
+  struct Ring {
+    static constexpr size_t kCapacity = 4096;
+    std::unique_ptr<Record[]> records{new Record[kCapacity]};
+    alignas(64) std::atomic<size_t> head{0};  // advanced by the writer thread
+    alignas(64) std::atomic<size_t> tail{0};  // advanced by the owning thread
+    std::atomic<bool> owned{true};  // cleared when the owning thread exits
+  };
+
+  // String literals and char buffers are all recorded as const char*
+  template <typename T>
+  using Stored = std::conditional_t<std::is_same<std::decay_t<T>, char *>::value,
+                                    const char *, std::decay_t<T>>;
+
+  // Binary encoding of one part. Arithmetic values and literal pointers are
+  // stored as-is; strings as a length byte plus up to kBudget characters.
+  template <typename T>
+  struct Part {
+    static_assert(std::is_arithmetic<T>::value, "unsupported log part type");
+    static constexpr size_t kFixed = sizeof(T);
+    static constexpr size_t kStrings = 0;
+    template <size_t kBudget>
+    static void Encode(unsigned char *&p, const T &value) {
+      std::memcpy(p, &value, sizeof(T));
+      p += sizeof(T);
+    }
+    static void Decode(const unsigned char *&p, std::string &out) {
+      T value;
+      std::memcpy(&value, p, sizeof(T));
+      p += sizeof(T);
+      Append(out, value);
+    }
+  };
+
+  template <typename T>
+  static void Append(std::string &out, T value) {
+    if constexpr (std::is_same<T, char>::value) {
+      out.push_back(value);
+    } else if constexpr (std::is_floating_point<T>::value) {
+      char text[32];
+      out.append(text, std::snprintf(text, sizeof(text), "%g", static_cast<double>(value)));
+    } else if constexpr (std::is_same<T, bool>::value) {
+      out.push_back(value ? '1' : '0');
+    } else {
+      char text[24];
+      out.append(text, std::to_chars(text, text + sizeof(text), value).ptr);
+    }
+  }
+
+  template <typename... Ts>
+  struct Formatter {
+    static constexpr size_t kFixedBytes = (size_t{0} + ... + Part<Ts>::kFixed);
+    static constexpr size_t kStrings = (size_t{0} + ... + Part<Ts>::kStrings);
+    // characters each std::string part may use
+    static constexpr size_t kBudget = kStrings == 0 ? 0 : (kPayload - kFixedBytes) / kStrings;
+
+    template <typename T>
+    static void Encode(unsigned char *&p, const T &value) {
+      Part<T>::template Encode<kBudget>(p, value);
+    }
+
+    static void Format(const unsigned char *p, std::string &out) {
+      (Part<Ts>::Decode(p, out), ...);
+      out.push_back('\n');
+    }
+  };
+
+  Ring &LocalRing() {
+    struct Lease {
+      Ring *ring;
+      ~Lease() { ring->owned.store(false, std::memory_order_release); }
+    };
+    thread_local Lease lease{Register()};
+    return *lease.ring;
+  }
+
+  // Rings stay owned by the logger, so records of finished threads still
+  // drain; a drained ring of a finished thread is reused instead of growing
+  // the list
+  Ring *Register() {
+    std::lock_guard<std::mutex> lock(m_lock);
+    for (auto &ring : m_rings) {
+      if (!ring->owned.load(std::memory_order_acquire) &&
+          ring->head.load(std::memory_order_acquire) ==
+              ring->tail.load(std::memory_order_relaxed)) {
+        ring->owned.store(true, std::memory_order_relaxed);
+        return ring.get();
+      }
+    }
+    m_rings.push_back(std::make_unique<Ring>());
+    return m_rings.back().get();
+  }
+
+  // Formats outside m_lock, which is only held to copy the ring list
+  bool Drain(std::vector<Ring *> &rings, std::string &buffer) {
+    bool any = false;
+    rings.clear();
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      for (auto &ring : m_rings) rings.push_back(ring.get());
+    }
+    for (Ring *ring : rings) {
+      size_t head = ring->head.load(std::memory_order_relaxed);
+      size_t tail = ring->tail.load(std::memory_order_acquire);
+      for (; head != tail; ++head) {
+        const Record &record = ring->records[head & (Ring::kCapacity - 1)];
+        record.format(record.payload, buffer);
+        any = true;
+      }
+      ring->head.store(head, std::memory_order_release);
+    }
+    return any;
+  }
+
+  void Run() {
+    std::string buffer;
+    buffer.reserve(1 << 20);
+    std::vector<Ring *> rings;
+    for (;;) {
+      bool stopping = m_stop.load(std::memory_order_acquire);
+      bool any = Drain(rings, buffer);
+      if (!buffer.empty()) {
+        std::fwrite(buffer.data(), 1, buffer.size(), m_out);
+        std::fflush(m_out);
+        buffer.clear();
+      }
+      m_passes.fetch_add(1, std::memory_order_release);
+      if (stopping) return;
+      if (!any) std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+
+  FILE *m_out;
+  std::mutex m_lock;  // guards m_rings; taken by a thread's first Log only
+  std::vector<std::unique_ptr<Ring>> m_rings;
+  std::atomic<bool> m_stop{false};
+  std::atomic<uint64_t> m_passes{0};
+  std::thread m_writer;
+};
+
+// Literal strings: only the pointer is recorded
+template <>
+struct AsyncLogger::Part<const char *> {
+  static constexpr size_t kFixed = sizeof(const char *);
+  static constexpr size_t kStrings = 0;
+  template <size_t kBudget>
+  static void Encode(unsigned char *&p, const char *value) {
+    std::memcpy(p, &value, sizeof(value));
+    p += sizeof(value);
+  }
+  static void Decode(const unsigned char *&p, std::string &out) {
+    const char *value;
+    std::memcpy(&value, p, sizeof(value));
+    p += sizeof(value);
+    out += value;
+  }
+};
+
+// Owned strings: copied into the record, truncated to the per-string budget
+template <>
+struct AsyncLogger::Part<std::string> {
+  static constexpr size_t kFixed = 1;
+  static constexpr size_t kStrings = 1;
+  template <size_t kBudget>
+  static void Encode(unsigned char *&p, const std::string &value) {
+    size_t length = value.size() < kBudget ? value.size() : kBudget;
+    length = length < 255 ? length : 255;
+    *p++ = static_cast<unsigned char>(length);
+    std::memcpy(p, value.data(), length);
+    p += length;
+  }
+  static void Decode(const unsigned char *&p, std::string &out) {
+    size_t length = *p++;
+    out.append(reinterpret_cast<const char *>(p), length);
+    p += length;
+  }
+};
+
+#endif  // ASYNC_LOGGER_H
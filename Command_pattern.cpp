@@ -10,7 +10,27 @@ Cons:
         - Each command will be separated into 1 class.
         - High number of classes and object working together. */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "AsyncLogger.h"
+#include "Epoch.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 using namespace std;
 enum class eLIGHT_STATE { ON, OFF };
@@ -32,7 +52,7 @@ class Device {
 };
 
 // Concrete receiver classes
-class Light : public Device {
+class Light final : public Device {
  public:
   Light(string name, eLIGHT_STATE state) : m_name(name), m_state(state) {}
 
@@ -41,14 +61,14 @@ class Light : public Device {
   void TurnOn() {
     if (m_state != eLIGHT_STATE::ON) {
       m_state = eLIGHT_STATE::ON;
-      cout << "Light is On\n";
+      AsyncLogger::Instance().Log("Light is On");
     }
   }
 
   void TurnOff() {
     if (m_state != eLIGHT_STATE::OFF) {
       m_state = eLIGHT_STATE::OFF;
-      cout << "Light is Off\n";
+      AsyncLogger::Instance().Log("Light is Off");
     }
   }
 
@@ -61,7 +81,7 @@ class Light : public Device {
   eLIGHT_STATE m_state;
 };
 
-class CeilingFan : public Device {
+class CeilingFan final : public Device {
  public:
   CeilingFan(string name, eLIGHT_STATE state) : m_name(name), m_state(state) {}
   virtual ~CeilingFan() = default;
@@ -69,14 +89,14 @@ class CeilingFan : public Device {
   void TurnOn() {
     if (m_state != eLIGHT_STATE::ON) {
       m_state = eLIGHT_STATE::ON;
-      cout << "CeilingFan is On\n";
+      AsyncLogger::Instance().Log("CeilingFan is On");
     }
   }
 
   void TurnOff() {
     if (m_state != eLIGHT_STATE::OFF) {
       m_state = eLIGHT_STATE::OFF;
-      cout << "CeilingFan is Off\n";
+      AsyncLogger::Instance().Log("CeilingFan is Off");
     }
   }
 
@@ -89,8 +109,143 @@ class CeilingFan : public Device {
   eLIGHT_STATE m_state;
 };
 
+// Packed storage for large device fleets. Instead of one heap object per
+// device, state is kept as bitsets indexed by a dense device id, names are
+// interned and the group is a plain id column, so a device costs two bits
+// plus a 4-byte name id and a 4-byte group id.
+enum class eDEVICE_KIND { LIGHT, CEILING_FAN };
+
+class DeviceRegistry {
+ public:
+  using DeviceId = uint32_t;
+  using GroupId = uint32_t;
+
+  DeviceId Add(const string& name, eDEVICE_KIND kind, eLIGHT_STATE state,
+               GroupId group = 0) {
+    DeviceId id = static_cast<DeviceId>(m_names.size());
+    if ((id & 63) == 0) {
+      m_on.push_back(0);
+      m_lights.push_back(0);
+    }
+    m_names.push_back(Intern(name));
+    m_groups.push_back(group);
+    Assign(m_on, id, state == eLIGHT_STATE::ON);
+    Assign(m_lights, id, kind == eDEVICE_KIND::LIGHT);
+    return id;
+  }
+
+  size_t Size() const { return m_names.size(); }
+
+  // Bytes of the per-device columns, without vector growth slack; the
+  // interned names are shared and not counted
+  size_t DeviceBytes() const {
+    return (m_on.size() + m_lights.size()) * sizeof(uint64_t) +
+           m_groups.size() * sizeof(GroupId) +
+           m_names.size() * sizeof(uint32_t);
+  }
+
+  eLIGHT_STATE State(DeviceId id) const {
+    return Test(m_on, id) ? eLIGHT_STATE::ON : eLIGHT_STATE::OFF;
+  }
+  void SetState(DeviceId id, eLIGHT_STATE state) {
+    Assign(m_on, id, state == eLIGHT_STATE::ON);
+  }
+  eDEVICE_KIND Kind(DeviceId id) const {
+    return Test(m_lights, id) ? eDEVICE_KIND::LIGHT : eDEVICE_KIND::CEILING_FAN;
+  }
+  const string& Name(DeviceId id) const { return m_strings[m_names[id]]; }
+  void SetName(DeviceId id, const string& name) { m_names[id] = Intern(name); }
+
+  // Bulk operations, e.g. "turn off all lights in group G"
+  void TurnOnGroup(GroupId group, eDEVICE_KIND kind) {
+    Apply(group, kind, true);
+  }
+  void TurnOffGroup(GroupId group, eDEVICE_KIND kind) {
+    Apply(group, kind, false);
+  }
+
+ private:
+  static bool Test(const vector<uint64_t>& bits, DeviceId id) {
+    return (bits[id >> 6] >> (id & 63)) & 1;
+  }
+  static void Assign(vector<uint64_t>& bits, DeviceId id, bool value) {
+    uint64_t mask = uint64_t{1} << (id & 63);
+    bits[id >> 6] = value ? bits[id >> 6] | mask : bits[id >> 6] & ~mask;
+  }
+
+  uint32_t Intern(const string& name) {
+    auto it = m_index.find(name);
+    if (it != m_index.end()) return it->second;
+    m_strings.push_back(name);
+    return m_index[name] = static_cast<uint32_t>(m_strings.size() - 1);
+  }
+
+  // Bit j set when ids[j] == group, for up to 64 ids. Eight ids per
+  // compare with AVX2.
+  static uint64_t GroupMask(const GroupId* ids, size_t count, GroupId group) {
+    uint64_t mask = 0;
+    size_t j = 0;
+#ifdef __AVX2__
+    const __m256i wanted = _mm256_set1_epi32(static_cast<int>(group));
+    for (; j + 8 <= count; j += 8) {
+      __m256i match = _mm256_cmpeq_epi32(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ids + j)),
+          wanted);
+      mask |= static_cast<uint64_t>(static_cast<uint32_t>(
+                  _mm256_movemask_ps(_mm256_castsi256_ps(match))))
+              << j;
+    }
+#endif
+    for (; j < count; ++j)
+      mask |= static_cast<uint64_t>(ids[j] == group) << j;
+    return mask;
+  }
+
+  // on = on | sel  or  on = on & ~sel, with sel = group & kind mask,
+  // one 64-device word at a time
+  void Apply(GroupId group, eDEVICE_KIND kind, bool on) {
+    uint64_t* state = m_on.data();
+    const GroupId* groups = m_groups.data();
+    const uint64_t* lights = m_lights.data();
+    const uint64_t flip = kind == eDEVICE_KIND::LIGHT ? 0 : ~uint64_t{0};
+    size_t devices = m_groups.size();
+    for (size_t i = 0; i < m_on.size(); ++i) {
+      size_t first = i * 64;
+      size_t count = devices - first < 64 ? devices - first : 64;
+      uint64_t sel = GroupMask(groups + first, count, group) & (lights[i] ^ flip);
+      state[i] = on ? state[i] | sel : state[i] & ~sel;
+    }
+  }
+
+  vector<uint64_t> m_on;                // 1 = ON
+  vector<uint64_t> m_lights;            // 1 = Light, 0 = CeilingFan
+  vector<GroupId> m_groups;             // group id per device
+  vector<uint32_t> m_names;             // interned name id per device
+  vector<string> m_strings;
+  unordered_map<string, uint32_t> m_index;
+};
+
+// Lightweight view of a registry entry through the Device interface
+class DeviceHandle final : public Device {
+ public:
+  DeviceHandle(DeviceRegistry* registry, DeviceRegistry::DeviceId id)
+      : m_registry(registry), m_id(id) {}
+
+  string GetDeviceName() const { return m_registry->Name(m_id); }
+
+  void SetDeviceName(string name) { m_registry->SetName(m_id, name); }
+
+  void TurnOn() { m_registry->SetState(m_id, eLIGHT_STATE::ON); }
+
+  void TurnOff() { m_registry->SetState(m_id, eLIGHT_STATE::OFF); }
+
+ private:
+  DeviceRegistry* m_registry;
+  DeviceRegistry::DeviceId m_id;
+};
+
 // Concrete Command classes
-class LightOnCommand : public Command {
+class LightOnCommand final : public Command {
  public:
   LightOnCommand(Light* light) : m_light(light) {}
 
@@ -114,7 +269,7 @@ class LightOnCommand : public Command {
   Light* m_light;
 };
 
-class LightOffCommand : public Command {
+class LightOffCommand final : public Command {
  public:
   LightOffCommand(Light* light) : m_light(light) {}
 
@@ -138,7 +293,7 @@ class LightOffCommand : public Command {
   Light* m_light;
 };
 
-class CeilingFanOnCommand : public Command {
+class CeilingFanOnCommand final : public Command {
  public:
   CeilingFanOnCommand(CeilingFan* fan) : m_ceiling(fan) {}
 
@@ -164,7 +319,7 @@ class CeilingFanOnCommand : public Command {
   CeilingFan* m_ceiling;
 };
 
-class CeilingFanOffCommand : public Command {
+class CeilingFanOffCommand final : public Command {
  public:
   CeilingFanOffCommand(CeilingFan* fan) : m_ceiling(fan) {}
 
@@ -190,43 +345,799 @@ class CeilingFanOffCommand : public Command {
   CeilingFan* m_ceiling;
 };
 
+// A queued unit of work: run a command forward or roll it back
+struct CommandOp {
+  const Command* cmd;
+  bool undo;
+
+  void Run() const {
+    if (undo)
+      cmd->undo();
+    else
+      cmd->execute();
+  }
+};
+
+// What a producer does when the command queue is full
+enum class eBACKPRESSURE { BLOCK, DROP, OVERWRITE };
+
+// Bounded lock-free MPMC ring (sequence-per-slot scheme). Every slot
+// carries its own sequence number, so producers only contend on the tail
+// counter, consumers only on the head counter, and a slot becomes visible
+// to consumers exactly in the order its ticket was taken.
+template <typename T>
+class BoundedRing {
+ public:
+  explicit BoundedRing(size_t capacity,
+                       eBACKPRESSURE policy = eBACKPRESSURE::BLOCK)
+      : m_policy(policy) {
+    size_t size = 2;
+    while (size < capacity) size <<= 1;
+    m_mask = size - 1;
+    m_slots = make_unique<Slot[]>(size);
+    for (size_t i = 0; i < size; ++i)
+      m_slots[i].seq.store(i, memory_order_relaxed);
+  }
+
+  BoundedRing(const BoundedRing&) = delete;
+  BoundedRing& operator=(const BoundedRing&) = delete;
+
+  // Returns false only when the value was dropped (DROP policy)
+  bool Push(const T& value) {
+    while (!TryPush(value)) {
+      switch (m_policy) {
+        case eBACKPRESSURE::DROP:
+          m_dropped.fetch_add(1, memory_order_relaxed);
+          return false;
+        case eBACKPRESSURE::OVERWRITE: {
+          // Evict the oldest value to make room, then retry
+          T oldest;
+          if (TryPop(oldest)) m_dropped.fetch_add(1, memory_order_relaxed);
+          break;
+        }
+        default:
+          this_thread::yield();
+      }
+    }
+    return true;
+  }
+
+  bool TryPush(const T& value) {
+    size_t pos = m_tail.load(memory_order_relaxed);
+    for (;;) {
+      Slot& slot = m_slots[pos & m_mask];
+      size_t seq = slot.seq.load(memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (m_tail.compare_exchange_weak(pos, pos + 1,
+                                         memory_order_relaxed)) {
+          slot.value = value;
+          slot.seq.store(pos + 1, memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;  // full
+      } else {
+        pos = m_tail.load(memory_order_relaxed);
+      }
+    }
+  }
+
+  bool TryPop(T& value) {
+    size_t pos = m_head.load(memory_order_relaxed);
+    for (;;) {
+      Slot& slot = m_slots[pos & m_mask];
+      size_t seq = slot.seq.load(memory_order_acquire);
+      intptr_t diff =
+          static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (m_head.compare_exchange_weak(pos, pos + 1,
+                                         memory_order_relaxed)) {
+          value = slot.value;
+          slot.seq.store(pos + m_mask + 1, memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;  // empty
+      } else {
+        pos = m_head.load(memory_order_relaxed);
+      }
+    }
+  }
+
+  size_t Dropped() const { return m_dropped.load(memory_order_relaxed); }
+
+ private:
+  struct alignas(64) Slot {
+    atomic<size_t> seq;
+    T value;
+  };
+
+  eBACKPRESSURE m_policy;
+  size_t m_mask;
+  unique_ptr<Slot[]> m_slots;
+  alignas(64) atomic<size_t> m_head{0};
+  alignas(64) atomic<size_t> m_tail{0};
+  alignas(64) atomic<size_t> m_dropped{0};
+};
+
+using CommandQueue = BoundedRing<CommandOp>;
+
+// Drains command queues on background threads. Each executor thread owns one
+// queue and a remote slot always maps to the same queue, so commands pressed
+// on one slot run in press order and a receiver is never driven by two
+// threads at once. An idle worker spins briefly, then parks until the next
+// submit wakes it.
+class CommandExecutor {
+ public:
+  CommandExecutor(size_t threads, size_t capacity,
+                  eBACKPRESSURE policy = eBACKPRESSURE::BLOCK)
+      : m_policy(policy) {
+    if (threads == 0) threads = 1;
+    for (size_t i = 0; i < threads; ++i)
+      m_queues.push_back(make_unique<Worker>(capacity, policy));
+    for (size_t i = 0; i < threads; ++i)
+      m_workers.emplace_back(&CommandExecutor::Run, this, i);
+  }
+
+  virtual ~CommandExecutor() { Stop(); }
+
+  // Under OVERWRITE a queued command can still be evicted after Submit
+  // returned true, so only the other policies promise it will run
+  bool Guaranteed() const { return m_policy != eBACKPRESSURE::OVERWRITE; }
+
+  // False when the command was dropped or the executor is stopped
+  bool Submit(int slot, const CommandOp& op) {
+    m_submitting.fetch_add(1);
+    if (!m_running.load()) {
+      m_submitting.fetch_sub(1);
+      return false;
+    }
+    Worker& worker = *m_queues[static_cast<size_t>(slot) % m_queues.size()];
+    bool queued = worker.queue.Push(op);
+    m_submitting.fetch_sub(1);
+    if (queued) Wake(worker);
+    return queued;
+  }
+
+  // Refuses new commands, executes everything already queued, then joins
+  // the workers
+  void Stop() {
+    m_running.store(false);
+    while (m_submitting.load() != 0) this_thread::yield();
+    m_closed.store(true);
+    for (auto& worker : m_queues) {
+      lock_guard<mutex> lock(worker->lock);
+      worker->wake.notify_one();
+    }
+    for (auto& worker : m_workers)
+      if (worker.joinable()) worker.join();
+  }
+
+ private:
+  static constexpr int kSpins = 64;
+
+  struct Worker {
+    Worker(size_t capacity, eBACKPRESSURE policy) : queue(capacity, policy) {}
+
+    CommandQueue queue;
+    mutex lock;
+    condition_variable wake;
+    atomic<bool> parked{false};
+  };
+
+  // A worker sets parked before its last look at the queue and a producer
+  // reads it after pushing, so one of the two always sees the other.
+  static void Wake(Worker& worker) {
+    if (!worker.parked.load()) return;
+    lock_guard<mutex> lock(worker.lock);
+    worker.wake.notify_one();
+  }
+
+  void Run(size_t index) {
+    Worker& worker = *m_queues[index];
+    CommandOp op;
+    for (int idle = 0;;) {
+      if (worker.queue.TryPop(op)) {
+        op.Run();
+        idle = 0;
+      } else if (m_closed.load()) {
+        if (!worker.queue.TryPop(op)) break;
+        op.Run();
+      } else if (++idle < kSpins) {
+        this_thread::yield();
+      } else {
+        bool popped;
+        {
+          unique_lock<mutex> lock(worker.lock);
+          worker.parked.store(true);
+          while (!(popped = worker.queue.TryPop(op)) && !m_closed.load())
+            worker.wake.wait(lock);
+          worker.parked.store(false);
+        }
+        if (popped) op.Run();
+        idle = 0;
+      }
+    }
+  }
+
+  eBACKPRESSURE m_policy;
+  vector<unique_ptr<Worker>> m_queues;
+  vector<thread> m_workers;
+  atomic<bool> m_running{true};
+  atomic<size_t> m_submitting{0};  // Submit calls past the running check
+  atomic<bool> m_closed{false};    // no Submit can push any more
+};
+
+// Bounded undo/redo history. Entries live in one array allocated up front
+// and reused as a ring, so recording a press never touches the heap; once
+// the ring is full the oldest entry is forgotten. Repeated presses of the
+// same command collapse into a single entry.
+class CommandHistory {
+ public:
+  struct Entry {
+    int slot;
+    const Command* cmd;
+    size_t presses;
+  };
+
+  explicit CommandHistory(size_t capacity)
+      : m_capacity(capacity == 0 ? 1 : capacity),
+        m_entries(make_unique<Entry[]>(m_capacity)) {}
+
+  // Records an executed command and discards anything left to redo
+  void Record(int slot, const Command* cmd) {
+    m_redo = 0;
+    if (m_size > 0) {
+      Entry& last = At(m_size - 1);
+      if (last.cmd == cmd && last.slot == slot) {
+        ++last.presses;
+        return;
+      }
+    }
+    if (m_size == m_capacity) {
+      m_begin = (m_begin + 1) % m_capacity;
+      --m_size;
+    }
+    At(m_size++) = Entry{slot, cmd, 1};
+  }
+
+  // Returns the entry to roll back, or nullptr when there is nothing to undo
+  const Entry* Undo() {
+    if (m_size == 0) return nullptr;
+    ++m_redo;
+    return &At(--m_size);
+  }
+
+  // Returns the entry to run again, or nullptr when there is nothing to redo
+  const Entry* Redo() {
+    if (m_redo == 0) return nullptr;
+    --m_redo;
+    return &At(m_size++);
+  }
+
+  size_t Size() const { return m_size; }
+
+ private:
+  Entry& At(size_t i) { return m_entries[(m_begin + i) % m_capacity]; }
+
+  size_t m_capacity;
+  unique_ptr<Entry[]> m_entries;
+  size_t m_begin = 0;  // oldest entry in the ring
+  size_t m_size = 0;   // entries that can be undone
+  size_t m_redo = 0;   // undone entries after m_size that can be redone
+};
+
+// A command bound to its concrete type. The concrete classes and their
+// receivers are final, so calling execute() through one of the typed
+// alternatives compiles to a direct call; any other Command falls back to
+// the virtual path.
+using BoundCommand =
+    variant<const Command*, const LightOnCommand*, const LightOffCommand*,
+            const CeilingFanOnCommand*, const CeilingFanOffCommand*>;
+
+inline BoundCommand BindCommand(const Command* cmd) {
+  if (auto c = dynamic_cast<const LightOnCommand*>(cmd)) return c;
+  if (auto c = dynamic_cast<const LightOffCommand*>(cmd)) return c;
+  if (auto c = dynamic_cast<const CeilingFanOnCommand*>(cmd)) return c;
+  if (auto c = dynamic_cast<const CeilingFanOffCommand*>(cmd)) return c;
+  return cmd;
+}
+
+struct ButtonPress {
+  int slot;
+  bool on;
+};
+
+// Slot bindings of the remote control. Bindings live in a flat
+// open-addressing table whose cells keep the on/off pair side by side, so
+// sparse slot ids cost one probe and there is no fixed slot count.
+// Each command is packed with its variant index into one atomic word, so
+// binding a new slot fills an empty cell in place and rebinding overwrites
+// the words; presses read them without taking a lock. Only growth copies
+// the table: the bigger copy is published with an atomic swap and the old
+// one is handed to Epoch for reclamation.
+class SlotTable {
+ public:
+  struct Entry {
+    int slot = -1;  // -1 marks an empty cell
+    BoundCommand on{static_cast<const Command*>(nullptr)};
+    BoundCommand off{static_cast<const Command*>(nullptr)};
+  };
+
+  struct Binding {
+    int slot;
+    Command* on;
+    Command* off;
+  };
+
+ private:
+  static_assert(alignof(Command) >= 8 && variant_size_v<BoundCommand> <= 8,
+                "the variant index is kept in the low pointer bits");
+
+  static uintptr_t Pack(const BoundCommand& bound) {
+    return visit([](auto cmd) { return reinterpret_cast<uintptr_t>(cmd); },
+                 bound) |
+           bound.index();
+  }
+
+  template <size_t I = 0>
+  static BoundCommand Unpack(uintptr_t bits) {
+    if constexpr (I + 1 < variant_size_v<BoundCommand>)
+      if ((bits & 7) != I) return Unpack<I + 1>(bits);
+    using CommandPtr = variant_alternative_t<I, BoundCommand>;
+    return BoundCommand(in_place_index<I>,
+                        reinterpret_cast<CommandPtr>(bits & ~uintptr_t{7}));
+  }
+
+  struct Cell {
+    atomic<int> slot{-1};  // published last when a cell is first filled
+    atomic<uintptr_t> on{0};
+    atomic<uintptr_t> off{0};
+  };
+
+  struct Snapshot {
+    explicit Snapshot(size_t capacity)
+        : mask(capacity - 1),
+          shift(64 - __builtin_ctzll(capacity)),
+          cells(new Cell[capacity]) {}
+
+    // Fibonacci hashing: takes the high bits of the product, so strided
+    // slot ids (multiples of a power of two) still spread over the table
+    size_t Hash(int slot) const {
+      return (uint64_t{static_cast<uint32_t>(slot)} * 0x9E3779B97F4A7C15ull) >>
+             shift;
+    }
+
+    const Cell* Find(int slot) const {
+      for (size_t i = Hash(slot);; i = (i + 1) & mask) {
+        int found = cells[i].slot.load(memory_order_acquire);
+        if (found == slot) return &cells[i];
+        if (found == -1) return nullptr;
+      }
+    }
+
+    // Writer only
+    void Store(int slot, uintptr_t on, uintptr_t off) {
+      size_t i = Hash(slot);
+      int found;
+      while ((found = cells[i].slot.load(memory_order_relaxed)) != -1 &&
+             found != slot)
+        i = (i + 1) & mask;
+      cells[i].on.store(on, memory_order_release);
+      cells[i].off.store(off, memory_order_release);
+      if (found == -1) {
+        cells[i].slot.store(slot, memory_order_release);
+        ++size;
+      }
+    }
+
+    size_t mask;
+    int shift;  // 64 - log2(capacity)
+    size_t size = 0;
+    unique_ptr<Cell[]> cells;
+  };
+
+ public:
+  // Pins the current snapshot for the lifetime of the guard
+  class ReadGuard {
+   public:
+    explicit ReadGuard(const SlotTable& table)
+        : m_snapshot(table.m_current.load(memory_order_acquire)) {}
+
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+
+    // False when the slot was never bound
+    bool Find(int slot, Entry& entry) const {
+      const Cell* cell = slot < 0 ? nullptr : m_snapshot->Find(slot);
+      if (cell == nullptr) return false;
+      entry.slot = slot;
+      entry.on = Unpack(cell->on.load(memory_order_acquire));
+      entry.off = Unpack(cell->off.load(memory_order_acquire));
+      return true;
+    }
+
+   private:
+    Epoch::Guard m_epoch;  // declared first: pinned before the load below
+    const Snapshot* m_snapshot;
+  };
+
+  SlotTable() : m_current(new Snapshot(8)) {}
+
+  virtual ~SlotTable() { delete m_current.load(); }
+
+  SlotTable(const SlotTable&) = delete;
+  SlotTable& operator=(const SlotTable&) = delete;
+
+  // Binds or rebinds several slots; copies the table only when it must grow
+  void Set(const Binding* bindings, size_t count) {
+    lock_guard<mutex> lock(m_writer);
+    Snapshot* current = m_current.load(memory_order_relaxed);
+    size_t capacity = current->mask + 1;
+    while (capacity < 2 * (current->size + count)) capacity <<= 1;
+
+    Snapshot* target = current;
+    if (capacity != current->mask + 1) {
+      target = new Snapshot(capacity);
+      for (size_t i = 0; i <= current->mask; ++i) {
+        const Cell& cell = current->cells[i];
+        int slot = cell.slot.load(memory_order_relaxed);
+        if (slot != -1)
+          target->Store(slot, cell.on.load(memory_order_relaxed),
+                        cell.off.load(memory_order_relaxed));
+      }
+    }
+    for (size_t i = 0; i < count; ++i) {
+      if (bindings[i].slot < 0) continue;
+      target->Store(bindings[i].slot, Pack(BindCommand(bindings[i].on)),
+                    Pack(BindCommand(bindings[i].off)));
+    }
+    if (target != current) {
+      m_current.store(target, memory_order_release);
+      Epoch::Retire(current);
+    }
+  }
+
+ private:
+  atomic<Snapshot*> m_current;
+  mutex m_writer;  // serializes rebinding only, never taken by presses
+};
+
 // Invoker class
 class SimpleRemoteControl {
  public:
-  SimpleRemoteControl() {
-    onCommand = new Command*[2];
-    offCommand = new Command*[2];
-    undoCommand = nullptr;
+  explicit SimpleRemoteControl(size_t history_depth = 16)
+      : history(history_depth) {
+    executor = nullptr;
   }
 
-  virtual ~SimpleRemoteControl() {
-    delete[] onCommand;
-    delete[] offCommand;
-  }
+  virtual ~SimpleRemoteControl() = default;
 
   void SetCommand(int slot, Command* on_cmd, Command* off_cmd) {
-    onCommand[slot] = on_cmd;
-    offCommand[slot] = off_cmd;
+    SlotTable::Binding binding{slot, on_cmd, off_cmd};
+    slots.Set(&binding, 1);
   }
 
-  void onButtonPressed(int slot) {
-    onCommand[slot]->execute();
-    undoCommand = onCommand[slot];
+  // Rebinds many slots at once; cheaper than one SetCommand per slot
+  void SetCommands(const SlotTable::Binding* bindings, size_t count) {
+    slots.Set(bindings, count);
   }
 
-  void offButtonPressed(int slot) {
-    offCommand[slot]->execute();
-    undoCommand = offCommand[slot];
+  // Once an executor is set, presses are queued instead of run inline
+  void SetExecutor(CommandExecutor* exec) { executor = exec; }
+
+  // Pressing an unbound slot does nothing
+  void onButtonPressed(int slot) { Press(ButtonPress{slot, true}); }
+
+  void offButtonPressed(int slot) { Press(ButtonPress{slot, false}); }
+
+  // Runs a batch of presses in order. Consecutive presses that resolve to the
+  // same concrete command type are executed as one run in a tight loop with
+  // no virtual dispatch; runs are never reordered, so presses touching the
+  // same device keep their effect.
+  void ExecuteBatch(const ButtonPress* presses, size_t count) {
+    if (executor != nullptr) {
+      for (size_t i = 0; i < count; ++i) Press(presses[i]);
+      return;
+    }
+    SlotTable::ReadGuard guard(slots);
+    // Per thread, so a small batch doesn't pay to construct a whole chunk
+    thread_local BoundCommand bound[kBatchChunk];
+    Pressed pressed[kBatchChunk];
+    for (size_t base = 0; base < count; base += kBatchChunk) {
+      // Each press is looked up once; unbound presses are skipped
+      size_t chunk = min(kBatchChunk, count - base), resolved = 0;
+      for (size_t i = 0; i < chunk; ++i) {
+        const ButtonPress& press = presses[base + i];
+        if (!Bound(guard, press, bound[resolved])) continue;
+        pressed[resolved] = Pressed{press.slot, Target(bound[resolved])};
+        ++resolved;
+      }
+      for (size_t begin = 0, end; begin < resolved; begin = end) {
+        for (end = begin + 1; end < resolved; ++end)
+          if (bound[end].index() != bound[begin].index()) break;
+        visit(
+            [&](auto head) {
+              using CommandPtr = decltype(head);
+              for (size_t i = begin; i < end; ++i)
+                get<CommandPtr>(bound[i])->execute();
+            },
+            bound[begin]);
+      }
+      RecordAll(pressed, resolved);
+    }
   }
 
-  void undoButtonPressed() const { undoCommand->undo(); }
+  // Does nothing when no press is left to undo. If the executor drops the
+  // undo, the entry stays in the history.
+  void undoButtonPressed() {
+    lock_guard<mutex> lock(history_lock);
+    DrainPressed();
+    if (const CommandHistory::Entry* entry = history.Undo())
+      if (!Dispatch(entry->slot, CommandOp{entry->cmd, true})) history.Redo();
+  }
+
+  void redoButtonPressed() {
+    lock_guard<mutex> lock(history_lock);
+    DrainPressed();
+    if (const CommandHistory::Entry* entry = history.Redo())
+      if (!Dispatch(entry->slot, CommandOp{entry->cmd, false})) history.Undo();
+  }
 
  private:
-  Command** onCommand;
-  Command** offCommand;
-  Command* undoCommand;
+  static const Command* Target(const BoundCommand& bound) {
+    return visit([](auto cmd) -> const Command* { return cmd; }, bound);
+  }
+
+  // Null when the slot is unbound or has no command for this button
+  static bool Bound(const SlotTable::ReadGuard& guard,
+                    const ButtonPress& press, BoundCommand& bound) {
+    SlotTable::Entry entry;
+    if (!guard.Find(press.slot, entry)) return false;
+    bound = press.on ? entry.on : entry.off;
+    return Target(bound) != nullptr;
+  }
+
+  void Press(const ButtonPress& press) {
+    SlotTable::ReadGuard guard(slots);
+    BoundCommand bound;
+    if (Bound(guard, press, bound)) {
+      const Command* cmd = Target(bound);
+      // A press the executor dropped never ran, so there is nothing to
+      // undo; one an OVERWRITE executor may still evict is not recorded
+      if (Dispatch(press.slot, CommandOp{cmd, false}) &&
+          (executor == nullptr || executor->Guaranteed()))
+        Record(press.slot, cmd);
+    }
+  }
+
+  struct Pressed {
+    int slot;
+    const Command* cmd;
+  };
+
+  // Lock-free: presses only append to m_pressed. The history lock is taken
+  // when the ring is full, i.e. once per kPressedCapacity presses at most.
+  void Record(int slot, const Command* cmd) {
+    while (!m_pressed.TryPush(Pressed{slot, cmd})) {
+      lock_guard<mutex> lock(history_lock);
+      DrainPressed();
+    }
+  }
+
+  // A batch goes straight into the history when the lock happens to be
+  // free, and through m_pressed otherwise; it never waits for the lock
+  void RecordAll(const Pressed* pressed, size_t count) {
+    unique_lock<mutex> lock(history_lock, try_to_lock);
+    if (!lock.owns_lock()) {
+      for (size_t i = 0; i < count; ++i) Record(pressed[i].slot, pressed[i].cmd);
+      return;
+    }
+    DrainPressed();
+    for (size_t i = 0; i < count; ++i)
+      history.Record(pressed[i].slot, pressed[i].cmd);
+  }
+
+  // Caller holds history_lock
+  void DrainPressed() {
+    Pressed pressed;
+    while (m_pressed.TryPop(pressed)) history.Record(pressed.slot, pressed.cmd);
+  }
+
+  // False when the executor dropped the command
+  bool Dispatch(int slot, const CommandOp& op) {
+    if (executor != nullptr) return executor->Submit(slot, op);
+    op.Run();
+    return true;
+  }
+
+  static constexpr size_t kPressedCapacity = 1024;
+  static constexpr size_t kBatchChunk = 256;  // presses resolved per pass
+
+  SlotTable slots;
+  BoundedRing<Pressed> m_pressed{kPressedCapacity};  // not yet in history
+  mutex history_lock;  // taken by undo/redo, and by a press that finds m_pressed full
+  CommandHistory history;
+  CommandExecutor* executor;
 };
 
+// Measurements printed by main(); sizes are kept small so the demo stays quick
+template <typename Body>
+double NanosPerOp(size_t ops, Body&& body) {
+  auto start = chrono::steady_clock::now();
+  body();
+  return chrono::duration<double, nano>(chrono::steady_clock::now() - start)
+             .count() /
+         ops;
+}
+
+// Pushes `total` no-op commands from `producers` threads into one consumer
+// thread, through CommandExecutor or through a mutex-guarded deque
+double QueueNanosPerOp(size_t producers, size_t total, bool locked) {
+  static const Command noop;
+  const size_t each = total / producers;
+  mutex lock;
+  condition_variable ready;
+  deque<CommandOp> baseline;
+  bool closed = false;
+  return NanosPerOp(each * producers, [&] {
+    unique_ptr<CommandExecutor> executor;
+    thread consumer;
+    if (locked) {
+      consumer = thread([&] {
+        unique_lock<mutex> guard(lock);
+        for (;;) {
+          ready.wait(guard, [&] { return closed || !baseline.empty(); });
+          if (baseline.empty()) return;
+          CommandOp op = baseline.front();
+          baseline.pop_front();
+          guard.unlock();
+          op.Run();
+          guard.lock();
+        }
+      });
+    } else {
+      executor = make_unique<CommandExecutor>(1, 1024);
+    }
+    vector<thread> threads;
+    for (size_t p = 0; p < producers; ++p)
+      threads.emplace_back([&, p] {
+        for (size_t i = 0; i < each; ++i) {
+          if (!locked) {
+            executor->Submit(static_cast<int>(p), CommandOp{&noop, false});
+            continue;
+          }
+          {
+            lock_guard<mutex> guard(lock);
+            baseline.push_back(CommandOp{&noop, false});
+          }
+          ready.notify_one();
+        }
+      });
+    for (auto& t : threads) t.join();
+    if (locked) {
+      {
+        lock_guard<mutex> guard(lock);
+        closed = true;
+      }
+      ready.notify_one();
+      consumer.join();
+    } else {
+      executor->Stop();
+    }
+  });
+}
+
+// p50/p99 of single press, undo and redo calls once the history is `depth`
+// entries deep. The slot is bound to base Commands, which do nothing, so
+// only the remote's own bookkeeping is timed.
+void PrintHistoryLatency(size_t depth) {
+  static Command on, off;
+  SimpleRemoteControl remote(depth);
+  remote.SetCommand(0, &on, &off);
+  for (size_t i = 0; i < depth; ++i) {
+    if (i % 2)
+      remote.offButtonPressed(0);
+    else
+      remote.onButtonPressed(0);
+  }
+  const size_t samples = 20000;
+  vector<double> press, undo, redo;
+  auto time = [](vector<double>& out, auto&& call) {
+    auto start = chrono::steady_clock::now();
+    call();
+    out.push_back(
+        chrono::duration<double, nano>(chrono::steady_clock::now() - start)
+            .count());
+  };
+  for (size_t i = 0; i < samples; ++i) {
+    time(press, [&] {
+      if (i % 2)
+        remote.offButtonPressed(0);
+      else
+        remote.onButtonPressed(0);
+    });
+    time(undo, [&] { remote.undoButtonPressed(); });
+    time(redo, [&] { remote.redoButtonPressed(); });
+  }
+  auto percentile = [](vector<double>& v, double p) {
+    auto at = v.begin() + static_cast<ptrdiff_t>(p * (v.size() - 1));
+    nth_element(v.begin(), at, v.end());
+    return *at;
+  };
+  cout << "history depth " << depth << ", p50/p99 ns: press "
+       << percentile(press, 0.5) << "/" << percentile(press, 0.99) << ", undo "
+       << percentile(undo, 0.5) << "/" << percentile(undo, 0.99) << ", redo "
+       << percentile(redo, 0.5) << "/" << percentile(redo, 0.99) << "\n";
+}
+
+// ns per press for one press at a time (a virtual execute() each) and for
+// ExecuteBatch. The lights start on and only get "on" presses, so no press
+// reaches the logger.
+void PrintBatchCost(size_t batch_size) {
+  SimpleRemoteControl remote;
+  for (int slot = 0; slot < 4; ++slot) {
+    Light* light = new Light("Bench Light", eLIGHT_STATE::ON);
+    remote.SetCommand(slot, new LightOnCommand(light), new LightOffCommand(light));
+  }
+  vector<ButtonPress> batch(batch_size);
+  for (size_t i = 0; i < batch_size; ++i)
+    batch[i] = ButtonPress{static_cast<int>(i % 4), true};
+  const size_t rounds = (1 << 20) / batch_size;
+  double single = NanosPerOp(rounds * batch_size, [&] {
+    for (size_t r = 0; r < rounds; ++r)
+      for (const ButtonPress& press : batch) remote.onButtonPressed(press.slot);
+  });
+  double batched = NanosPerOp(rounds * batch_size, [&] {
+    for (size_t r = 0; r < rounds; ++r)
+      remote.ExecuteBatch(batch.data(), batch.size());
+  });
+  cout << "batch of " << batch_size << ", ns per press: one at a time "
+       << single << ", batched " << batched << "\n";
+}
+
+// Memory per device and bulk group toggles per second for a fleet of
+// `devices` lights and fans spread over 16 groups
+void PrintRegistryCost(size_t devices) {
+  DeviceRegistry registry;
+  for (size_t i = 0; i < devices; ++i)
+    registry.Add(i % 2 ? "Hall Light" : "Hall Fan",
+                 i % 2 ? eDEVICE_KIND::LIGHT : eDEVICE_KIND::CEILING_FAN,
+                 eLIGHT_STATE::OFF, static_cast<uint32_t>(i % 16));
+  const size_t toggles = 32;
+  double per_device = NanosPerOp(toggles * devices, [&] {
+    for (size_t t = 0; t < toggles; ++t)
+      registry.TurnOnGroup(static_cast<uint32_t>(t % 16), eDEVICE_KIND::LIGHT);
+  });
+  cout << devices << " devices: "
+       << static_cast<double>(registry.DeviceBytes()) / devices
+       << " bytes each, bulk toggle " << 1 / per_device
+       << " billion devices scanned per second\n";
+}
+
+// ns per press on random slots of a remote with `slot_count` bound slots.
+// Every slot holds base Commands, which do nothing, so the slot lookup and
+// the history dominate.
+void PrintPressCost(size_t slot_count) {
+  static Command on, off;
+  SimpleRemoteControl remote;
+  vector<SlotTable::Binding> bindings;
+  for (size_t i = 0; i < slot_count; ++i)
+    bindings.push_back(SlotTable::Binding{static_cast<int>(i), &on, &off});
+  remote.SetCommands(bindings.data(), bindings.size());
+  vector<int> order(1 << 20);
+  uint32_t seed = 1;
+  for (int& slot : order) {
+    seed = seed * 1664525u + 1013904223u;
+    slot = static_cast<int>((seed >> 8) % slot_count);
+  }
+  double per_press = NanosPerOp(order.size(), [&] {
+    for (int slot : order) remote.onButtonPressed(slot);
+  });
+  cout << slot_count << " slots, ns per press: " << per_press << "\n";
+}
+
 // Act as client role
 int main() {
   SimpleRemoteControl* remote = new SimpleRemoteControl();
@@ -242,9 +1153,40 @@ int main() {
 
   remote->onButtonPressed(0);  // light on
   remote->onButtonPressed(1);  // fan on
+  for (size_t slot_count : {2, 100000}) PrintPressCost(slot_count);
 
   remote->offButtonPressed(0);  // light off
   remote->undoButtonPressed();  // light on
+  remote->redoButtonPressed();  // light off
+  remote->undoButtonPressed();  // light on
+  for (size_t depth : {16, 1024, 1 << 20}) PrintHistoryLatency(depth);
+
+  // Batched presses, run without virtual dispatch
+  ButtonPress batch[] = {{0, false}, {1, false}, {0, true}, {1, true}};
+  remote->ExecuteBatch(batch, sizeof(batch) / sizeof(batch[0]));
+  for (size_t batch_size : {1, 16, 256, 4096}) PrintBatchCost(batch_size);
+
+  // Queued presses, drained by a background executor thread
+  CommandExecutor executor(1, 64);
+  remote->SetExecutor(&executor);
+  remote->offButtonPressed(1);  // fan off
+  remote->onButtonPressed(1);   // fan on
+  executor.Stop();
+
+  for (size_t producers : {1, 4, 16, 32})
+    cout << producers << " producers, ns per queued command: lock-free "
+         << QueueNanosPerOp(producers, 1 << 18, false) << ", mutex+deque "
+         << QueueNanosPerOp(producers, 1 << 18, true) << "\n";
+
+  // Fleet of devices in packed storage, bulk-toggled per group
+  DeviceRegistry registry;
+  for (int i = 0; i < 1000; ++i)
+    registry.Add("Hall Light", eDEVICE_KIND::LIGHT, eLIGHT_STATE::ON, i % 4);
+  DeviceHandle hall(&registry, registry.Add("Hall Fan", eDEVICE_KIND::CEILING_FAN,
+                                            eLIGHT_STATE::OFF, 2));
+  hall.TurnOn();
+  registry.TurnOffGroup(2, eDEVICE_KIND::LIGHT);  // fan in group 2 stays on
+  for (size_t devices : {1000000, 10000000}) PrintRegistryCost(devices);
 
   return 0;
 }
@@ -0,0 +1,160 @@
+/* Epoch-based reclamation shared by the pattern examples.
+Lock-free readers of a copy-on-write structure pin the current epoch for as long as they hold a
+pointer into it:
+    Epoch::Guard guard;
+    const Table* table = m_table.load();   // use table while guard lives
+A writer that unlinks an old version hands it to Epoch::Retire, which frees it once every thread
+that was pinned at that point has unpinned. Pinning only writes the calling thread's own
+cache-line-sized slot, so readers never contend with each other. Guards nest.
+Retired objects are freed by later Retire, Reclaim or Synchronize calls; deleters must not call
+Retire.
+*/
+
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class Epoch {
+ private:
+  struct Retired {
+    void *object;
+    void (*deleter)(void *);
+    uint64_t epoch;  // readers pinned at or before this epoch may hold it
+  };
+
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> epoch{0};  // 0 while not pinned
+    std::atomic<bool> used{false};
+    unsigned depth = 0;  // owner thread only
+  };
+
+  struct State {
+    std::atomic<uint64_t> epoch{1};
+    std::mutex lock;  // guards slots and retired; never taken by readers
+    std::vector<std::unique_ptr<Slot>> slots;
+    std::vector<Retired> retired;
+  };
+
+ public:
+  class Guard {
+   public:
+    Guard() : m_slot(Local()) {
+      if (m_slot.depth++ == 0) {
+        // a full barrier: the pin must be visible before any pointer the
+        // reader loads next
+        m_slot.epoch.exchange(Global().epoch.load(), std::memory_order_seq_cst);
+      }
+    }
+    ~Guard() {
+      if (--m_slot.depth == 0) m_slot.epoch.store(0, std::memory_order_release);
+    }
+
+    Guard(const Guard &) = delete;
+    Guard &operator=(const Guard &) = delete;
+
+   private:
+    Slot &m_slot;
+  };
+
+  // Call after the object has been unlinked from every shared pointer
+  template <typename T>
+  static void Retire(const T *object) {
+    Retire(const_cast<T *>(object), [](void *p) { delete static_cast<T *>(p); });
+  }
+
+  static void Retire(void *object, void (*deleter)(void *)) {
+    State &state = Global();
+    {
+      std::lock_guard<std::mutex> lock(state.lock);
+      state.retired.push_back({object, deleter, state.epoch.fetch_add(1)});
+    }
+    Reclaim();
+  }
+
+  // Frees every retired object no pinned reader can still reach
+  static void Reclaim() {
+    State &state = Global();
+    std::vector<Retired> ready;
+    {
+      std::lock_guard<std::mutex> lock(state.lock);
+      uint64_t oldest = state.epoch.load();
+      for (const auto &slot : state.slots) {
+        uint64_t pinned = slot->epoch.load();
+        if (pinned != 0 && pinned < oldest) oldest = pinned;
+      }
+      size_t kept = 0;
+      for (const Retired &retired : state.retired) {
+        if (retired.epoch < oldest)
+          ready.push_back(retired);
+        else
+          state.retired[kept++] = retired;
+      }
+      state.retired.resize(kept);
+    }
+    for (const Retired &retired : ready) retired.deleter(retired.object);
+  }
+
+  // Waits until every guard that was live at the call has been released.
+  // Must not be called while the calling thread holds a Guard.
+  static void Synchronize() {
+    State &state = Global();
+    uint64_t target = state.epoch.fetch_add(1);
+    std::vector<const Slot *> slots;
+    {
+      std::lock_guard<std::mutex> lock(state.lock);
+      for (const auto &slot : state.slots) slots.push_back(slot.get());
+    }
+    for (const Slot *slot : slots) {
+      for (;;) {
+        uint64_t pinned = slot->epoch.load();
+        if (pinned == 0 || pinned > target) break;
+        std::this_thread::yield();
+      }
+    }
+    Reclaim();
+  }
+
+ private:
+  // Never destroyed, so guards stay usable during static destruction
+  static State &Global() {
+    static State *state = new State();
+    return *state;
+  }
+
+  // A thread takes a free slot on its first pin and hands it back on exit
+  static Slot &Local() {
+    struct Lease {
+      Slot *slot = nullptr;
+      ~Lease() {
+        if (slot) slot->used.store(false, std::memory_order_release);
+      }
+    };
+    thread_local Lease lease;
+    if (lease.slot == nullptr) {
+      State &state = Global();
+      std::lock_guard<std::mutex> lock(state.lock);
+      for (auto &slot : state.slots) {
+        if (!slot->used.load(std::memory_order_relaxed)) {
+          slot->used.store(true, std::memory_order_relaxed);
+          lease.slot = slot.get();
+          break;
+        }
+      }
+      if (lease.slot == nullptr) {
+        state.slots.push_back(std::make_unique<Slot>());
+        state.slots.back()->used.store(true, std::memory_order_relaxed);
+        lease.slot = state.slots.back().get();
+      }
+    }
+    return *lease.slot;
+  }
+};
+
+#endif  // EPOCH_H
@@ -4,9 +4,24 @@ Pros:
 Cons:
 */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <random>
+#include <functional>
+#include <string>
+#include <thread>
 #include <utility>
+#include <vector>
+
+#include "AsyncLogger.h"
+#include "Epoch.h"
 
 using namespace std;
 
@@ -16,18 +31,365 @@ enum class Investment_Type {
     real_estate 
 };
 
+// Concurrent find-or-insert map for read-mostly data (entries are never
+// removed). Keys are spread over shards; each shard is an open-addressing
+// table of atomic node pointers. Readers probe without locking, writers of
+// one shard serialize on its mutex and fill empty slots in place, so a
+// reader sees either nothing or a fully built node. Only growth swaps in a
+// new table; the old one goes to Epoch and is freed once no reader can
+// still be probing it.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class ShardedCache {
+ public:
+  static constexpr size_t kShards = 64;
+
+  ShardedCache() = default;
+  ShardedCache(const ShardedCache &) = delete;
+  ShardedCache &operator=(const ShardedCache &) = delete;
+
+  ~ShardedCache() {
+    for (Shard &shard : m_shards) delete shard.table.load();
+  }
+
+  // Null when absent; the value lives as long as the cache
+  const Value *Find(const Key &key) const {
+    size_t hash = Hash()(key);
+    Epoch::Guard guard;
+    const Node *node = Probe(ShardOf(hash).table.load(), hash, key);
+    return node != nullptr ? &node->value : nullptr;
+  }
+
+  // make() runs at most once per key, under the shard's writer lock
+  template <typename Make>
+  const Value &FindOrInsert(const Key &key, Make make) {
+    if (const Value *value = Find(key)) return *value;
+    size_t hash = Hash()(key);
+    Shard &shard = ShardOf(hash);
+    std::lock_guard<std::mutex> lock(shard.writer);
+    const Table *table = shard.table.load();
+    if (const Node *node = Probe(table, hash, key)) return node->value;
+
+    shard.nodes.push_back(std::make_unique<Node>(Node{hash, key, make()}));
+    const Node *node = shard.nodes.back().get();
+    if (table == nullptr || 2 * (table->size + 1) > table->mask + 1) {
+      Table *bigger = new Table(table == nullptr ? 16 : 2 * (table->mask + 1));
+      if (table != nullptr) {
+        for (size_t i = 0; i <= table->mask; ++i)
+          if (const Node *old = table->slots[i].load(std::memory_order_relaxed))
+            bigger->Place(old);
+      }
+      bigger->Place(node);
+      shard.table.store(bigger);
+      if (table != nullptr) Epoch::Retire(table);
+    } else {
+      const_cast<Table *>(table)->Place(node);
+    }
+    return node->value;
+  }
+
+ private:
+  struct Node {
+    size_t hash;
+    Key key;
+    Value value;
+  };
+
+  struct Table {
+    explicit Table(size_t capacity)
+        : mask(capacity - 1),
+          slots(new std::atomic<const Node *>[capacity]) {
+      for (size_t i = 0; i < capacity; ++i)
+        slots[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    void Place(const Node *node) {
+      size_t i = node->hash & mask;
+      while (slots[i].load(std::memory_order_relaxed) != nullptr)
+        i = (i + 1) & mask;
+      slots[i].store(node, std::memory_order_release);
+      ++size;
+    }
+
+    size_t mask;
+    size_t size = 0;
+    std::unique_ptr<std::atomic<const Node *>[]> slots;
+  };
+
+  struct alignas(64) Shard {
+    std::atomic<const Table *> table{nullptr};
+    std::mutex writer;
+    std::vector<std::unique_ptr<Node>> nodes;
+  };
+
+  static const Node *Probe(const Table *table, size_t hash, const Key &key) {
+    if (table == nullptr) return nullptr;
+    for (size_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+      const Node *node = table->slots[i].load(std::memory_order_acquire);
+      if (node == nullptr) return nullptr;
+      if (node->hash == hash && node->key == key) return node;
+    }
+  }
+
+  // Scrambled high bits pick the shard (std::hash of integers is the
+  // identity), low bits pick the slot inside it
+  static size_t ShardIndex(size_t hash) {
+    return static_cast<size_t>((static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull) >> 58) % kShards;
+  }
+  Shard &ShardOf(size_t hash) { return m_shards[ShardIndex(hash)]; }
+  const Shard &ShardOf(size_t hash) const { return m_shards[ShardIndex(hash)]; }
+
+  Shard m_shards[kShards];
+};
+
+using TickerId = uint32_t;
+
+// Compact id for a ticker; the same string always maps to the same id
+inline TickerId InternTicker(const std::string &sticker) {
+  static ShardedCache<std::string, TickerId> tickers;
+  static std::atomic<TickerId> next_id{0};
+  return tickers.FindOrInsert(sticker, [] { return next_id++; });
+}
+
+// Execution engine
+enum class Side { buy, sell };
+
+struct Order {
+  uint64_t id;  // assigned by the book on submit
+  Side side;
+  int price;  // limit price in ticks
+  uint32_t quantity;
+};
+
+struct Fill {
+  uint64_t buy_id;
+  uint64_t sell_id;
+  int price;
+  uint32_t quantity;
+};
+
+// Limit order book for one ticker. Every price tick in [min_price,
+// max_price] has a level holding a FIFO of resting orders; the FIFO is an
+// intrusive list threaded through a node pool that is reserved up front and
+// recycled through a free list, so matching an order allocates nothing.
+class OrderBook {
+ public:
+  OrderBook(int min_price, int max_price, size_t reserve_orders = 1 << 16)
+      : m_min_price(min_price),
+        m_levels(static_cast<size_t>(max_price - min_price + 1)),
+        m_best_bid(-1),
+        m_best_ask(static_cast<int>(m_levels.size())) {
+    m_nodes.reserve(reserve_orders);
+  }
+
+  // Numbers each order of a batch and matches them in arrival order,
+  // appending fills to `fills`. The book is the only source of order ids,
+  // so ids never repeat within a book; callers read them back from
+  // `orders`. Returns how many orders were rejected for an out-of-range
+  // price.
+  size_t Submit(Order *orders, size_t count, std::vector<Fill> &fills) {
+    size_t rejected = 0;
+    for (size_t i = 0; i < count; ++i) {
+      orders[i].id = ++m_last_id;
+      if (!Match(orders[i], fills)) ++rejected;
+    }
+    return rejected;
+  }
+
+  // Best prices, or false when that side is empty
+  bool BestBid(int &price) const {
+    if (m_best_bid < 0) return false;
+    price = m_best_bid + m_min_price;
+    return true;
+  }
+  bool BestAsk(int &price) const {
+    if (m_best_ask >= static_cast<int>(m_levels.size())) return false;
+    price = m_best_ask + m_min_price;
+    return true;
+  }
+
+ private:
+  static constexpr uint32_t kNone = UINT32_MAX;
+
+  struct Node {
+    uint64_t id;
+    uint32_t quantity;
+    uint32_t next;
+  };
+
+  struct Level {
+    uint32_t head = kNone;
+    uint32_t tail = kNone;
+  };
+
+  bool Match(const Order &order, std::vector<Fill> &fills) {
+    int index = order.price - m_min_price;
+    if (index < 0 || index >= static_cast<int>(m_levels.size())) return false;
+    uint32_t remaining = order.quantity;
+    if (order.side == Side::buy) {
+      while (remaining > 0 && m_best_ask <= index) {
+        remaining = Take(m_best_ask, order, remaining, fills);
+        if (m_levels[m_best_ask].head == kNone) AdvanceAsk();
+      }
+    } else {
+      while (remaining > 0 && m_best_bid >= index) {
+        remaining = Take(m_best_bid, order, remaining, fills);
+        if (m_levels[m_best_bid].head == kNone) AdvanceBid();
+      }
+    }
+    if (remaining > 0) Rest(index, order, remaining);
+    return true;
+  }
+
+  // Fills against the resting FIFO at one level, oldest order first
+  uint32_t Take(int index, const Order &order, uint32_t remaining,
+                std::vector<Fill> &fills) {
+    Level &level = m_levels[index];
+    while (remaining > 0 && level.head != kNone) {
+      Node &resting = m_nodes[level.head];
+      uint32_t quantity = std::min(remaining, resting.quantity);
+      bool buy = order.side == Side::buy;
+      fills.push_back(Fill{buy ? order.id : resting.id,
+                           buy ? resting.id : order.id,
+                           index + m_min_price, quantity});
+      remaining -= quantity;
+      resting.quantity -= quantity;
+      if (resting.quantity == 0) {
+        uint32_t done = level.head;
+        level.head = resting.next;
+        if (level.head == kNone) level.tail = kNone;
+        Free(done);
+      }
+    }
+    return remaining;
+  }
+
+  void Rest(int index, const Order &order, uint32_t quantity) {
+    uint32_t node = Allocate(Node{order.id, quantity, kNone});
+    Level &level = m_levels[index];
+    if (level.tail == kNone)
+      level.head = node;
+    else
+      m_nodes[level.tail].next = node;
+    level.tail = node;
+    if (order.side == Side::buy)
+      m_best_bid = std::max(m_best_bid, index);
+    else
+      m_best_ask = std::min(m_best_ask, index);
+  }
+
+  void AdvanceAsk() {
+    int end = static_cast<int>(m_levels.size());
+    while (m_best_ask < end && m_levels[m_best_ask].head == kNone) ++m_best_ask;
+  }
+
+  void AdvanceBid() {
+    while (m_best_bid >= 0 && m_levels[m_best_bid].head == kNone) --m_best_bid;
+  }
+
+  uint32_t Allocate(const Node &node) {
+    if (m_free != kNone) {
+      uint32_t index = m_free;
+      m_free = m_nodes[index].next;
+      m_nodes[index] = node;
+      return index;
+    }
+    m_nodes.push_back(node);
+    return static_cast<uint32_t>(m_nodes.size() - 1);
+  }
+
+  void Free(uint32_t index) {
+    m_nodes[index].next = m_free;
+    m_free = index;
+  }
+
+  int m_min_price;
+  std::vector<Level> m_levels;
+  std::vector<Node> m_nodes;
+  uint32_t m_free = kNone;
+  int m_best_bid;  // level index, -1 when there are no bids
+  int m_best_ask;  // level index, m_levels.size() when there are no asks
+  uint64_t m_last_id = 0;
+};
+
+// One order book per ticker, found by its interned TickerId so routing an
+// order never hashes the ticker string. Each book has its own lock, so
+// orders for different tickers never wait for each other.
+class ExecutionEngine {
+ public:
+  ExecutionEngine(int min_price = 1, int max_price = 100000)
+      : m_min_price(min_price), m_max_price(max_price) {}
+
+  // Unsynchronized access for single-threaded inspection
+  OrderBook &Book(TickerId ticker) { return SlotOf(ticker).book; }
+
+  size_t Submit(TickerId ticker, Order *orders, size_t count,
+                std::vector<Fill> &fills) {
+    Slot &slot = SlotOf(ticker);
+    std::lock_guard<std::mutex> lock(slot.lock);
+    return slot.book.Submit(orders, count, fills);
+  }
+
+  // One order
+  void Place(TickerId ticker, Side side, int price, uint32_t quantity,
+             std::vector<Fill> &fills) {
+    Slot &slot = SlotOf(ticker);
+    std::lock_guard<std::mutex> lock(slot.lock);
+    Order order{0, side, price, quantity};
+    slot.book.Submit(&order, 1, fills);
+  }
+
+ private:
+  struct Slot {
+    Slot(int min_price, int max_price) : book(min_price, max_price) {}
+    std::mutex lock;
+    OrderBook book;
+  };
+
+  Slot &SlotOf(TickerId ticker) {
+    return *m_books.FindOrInsert(ticker, [this] {
+      return std::make_unique<Slot>(m_min_price, m_max_price);
+    });
+  }
+
+  int m_min_price;
+  int m_max_price;
+  ShardedCache<TickerId, std::unique_ptr<Slot>> m_books;
+};
+
 // Base Class
 class IFInvestment {
  public:
   IFInvestment() {}
   virtual ~IFInvestment() {}
 
-  virtual void Buy(const int &price) = 0;
-  virtual void Sell(const int &price) = 0;
+  // Fills of the order are appended to `fills` when given; the instrument
+  // keeps none of them
+  virtual void Buy(const int &price, std::vector<Fill> *fills = nullptr) = 0;
+  virtual void Sell(const int &price, std::vector<Fill> *fills = nullptr) = 0;
+
+  // Once attached, Buy/Sell place a one-unit limit order on the ticker's
+  // book. Instruments from MakeInvestment are shared, so this routes the
+  // orders of every holder.
+  void Attach(ExecutionEngine *engine) { m_engine.store(engine); }
 
  protected:
-  int m_price;
+  void Execute(Side side, int price, std::vector<Fill> *fills) {
+    ExecutionEngine *engine = m_engine.load();
+    if (engine == nullptr) return;
+    if (fills != nullptr) {
+      engine->Place(m_ticker, side, price, 1, *fills);
+      return;
+    }
+    thread_local std::vector<Fill> discarded;
+    engine->Place(m_ticker, side, price, 1, discarded);
+    discarded.clear();
+  }
+
+  // Set once by the constructor; an instrument keeps no per-trade state, so
+  // a shared one can trade on many threads at once
   string m_sticker;
+  TickerId m_ticker;
+  std::atomic<ExecutionEngine *> m_engine{nullptr};
 };
 
 // Stock
@@ -35,21 +397,19 @@ class Stock : public IFInvestment {
  public:
   Stock(const std::string &sticker) {
     m_sticker = sticker;
-    m_price = 0;
+    m_ticker = InternTicker(sticker);
   }
 
   virtual ~Stock() {}
 
-  void Buy(const int &price) {
-    m_price = price;
-    std::cout << "buying " << m_sticker << " with price: " << m_price
-              << std::endl;
+  void Buy(const int &price, std::vector<Fill> *fills = nullptr) {
+    Execute(Side::buy, price, fills);
+    AsyncLogger::Instance().Log("buying ", m_sticker, " with price: ", price);
   }
 
-  void Sell(const int &price) {
-    m_price = price;
-    std::cout << "selling " << m_sticker << " with price: " << m_price
-              << std::endl;
+  void Sell(const int &price, std::vector<Fill> *fills = nullptr) {
+    Execute(Side::sell, price, fills);
+    AsyncLogger::Instance().Log("selling ", m_sticker, " with price: ", price);
   }
 };
 
@@ -58,20 +418,18 @@ class Bond : public IFInvestment {
  public:
   Bond(const std::string &sticker) {
     m_sticker = sticker;
-    m_price = 0;
+    m_ticker = InternTicker(sticker);
   }
   virtual ~Bond() {}
 
-  void Buy(const int &price) {
-    std::cout << "buying " << m_sticker << " with price: " << price
-              << std::endl;
-    m_price = price;
+  void Buy(const int &price, std::vector<Fill> *fills = nullptr) {
+    AsyncLogger::Instance().Log("buying ", m_sticker, " with price: ", price);
+    Execute(Side::buy, price, fills);
   }
 
-  void Sell(const int &price) {
-    std::cout << "selling " << m_sticker << " with price: " << price
-              << std::endl;
-    m_price = price;
+  void Sell(const int &price, std::vector<Fill> *fills = nullptr) {
+    AsyncLogger::Instance().Log("selling ", m_sticker, " with price: ", price);
+    Execute(Side::sell, price, fills);
   }
 };
 
@@ -80,27 +438,40 @@ class RealEstate : public IFInvestment {
  public:
   RealEstate(std::string sticker) {
     m_sticker = sticker;
-    m_price = 0;
+    m_ticker = InternTicker(sticker);
   }
   virtual ~RealEstate() {}
 
-  void Buy(const int &price) {
-    std::cout << "buying " << m_sticker << " with price: " << price
-              << std::endl;
-    m_price = price;
+  void Buy(const int &price, std::vector<Fill> *fills = nullptr) {
+    AsyncLogger::Instance().Log("buying ", m_sticker, " with price: ", price);
+    Execute(Side::buy, price, fills);
   }
 
-  void Sell(const int &price) {
-    std::cout << "selling " << m_sticker << " with price: " << price
-              << std::endl;
-    m_price = price;
+  void Sell(const int &price, std::vector<Fill> *fills = nullptr) {
+    AsyncLogger::Instance().Log("selling ", m_sticker, " with price: ", price);
+    Execute(Side::sell, price, fills);
   }
 };
 
 //Factory method
 class TradingFactory {
  public:
-  static std::unique_ptr<IFInvestment> MakeInvestment(const Investment_Type &type, const std::string &sticker) {
+  // Compact id for a ticker; the same string always maps to the same id
+  static TickerId Intern(const std::string &sticker) { return InternTicker(sticker); }
+
+  // One shared instrument per (ticker, type). Repeated lookups return the
+  // cached instance without allocating or locking. Every caller gets the same
+  // object; it is safe to trade on from many threads since instruments hold
+  // no per-trade state.
+  static std::shared_ptr<IFInvestment> MakeInvestment(const Investment_Type &type, const std::string &sticker) {
+    uint64_t key = static_cast<uint64_t>(Intern(sticker)) << 2 | static_cast<uint64_t>(type);
+    return Instruments().FindOrInsert(key, [&] {
+      return std::shared_ptr<IFInvestment>(CreateInvestment(type, sticker));
+    });
+  }
+
+  // A new, uncached instrument
+  static std::unique_ptr<IFInvestment> CreateInvestment(const Investment_Type &type, const std::string &sticker) {
     switch (type) {
       case Investment_Type::stock:
         return std::make_unique<Stock>(sticker);
@@ -112,12 +483,305 @@ class TradingFactory {
         return std::make_unique<RealEstate>(sticker);
     }
   }
+
+ private:
+  static ShardedCache<uint64_t, std::shared_ptr<IFInvestment>> &Instruments() {
+    static ShardedCache<uint64_t, std::shared_ptr<IFInvestment>> instruments;
+    return instruments;
+  }
+};
+
+// Portfolio valuation
+struct Valuation {
+  double market_value = 0;
+  double cost = 0;
+  double pnl = 0;
+  double exposure[3] = {};  // market value per Investment_Type
 };
 
+// Positions stored column by column (instrument id, quantity, cost basis),
+// one set of columns per Investment_Type, so a revaluation streams through
+// flat arrays instead of making a virtual call per IFInvestment, and the
+// exposure per type needs no per-position test.
+class Portfolio {
+ public:
+  static constexpr size_t kTypes = 3;
+
+  void Add(const Investment_Type &type, const std::string &sticker,
+           double quantity, double cost_basis) {
+    Columns &columns = m_columns[static_cast<size_t>(type)];
+    columns.ids.push_back(TradingFactory::Intern(sticker));
+    columns.quantity.push_back(quantity);
+    columns.cost.push_back(cost_basis);
+  }
+
+  size_t Size() const {
+    size_t n = 0;
+    for (const Columns &columns : m_columns) n += columns.ids.size();
+    return n;
+  }
+
+  // prices[id] is the current price of the instrument with TickerId id.
+  // Work is split into one contiguous chunk per thread; partial results are
+  // summed in chunk order, so the result does not depend on scheduling.
+  Valuation Revalue(const std::vector<double> &prices, unsigned threads = 1) const {
+    size_t n = Size();
+    if (threads <= 1 || n < 65536) return RevalueRange(prices.data(), 0, n);
+    std::vector<Valuation> partial(threads);
+    std::vector<std::thread> workers;
+    size_t chunk = (n + threads - 1) / threads;
+    for (unsigned t = 0; t < threads; ++t) {
+      size_t begin = std::min(n, t * chunk), end = std::min(n, begin + chunk);
+      workers.emplace_back([&, t, begin, end] {
+        partial[t] = RevalueRange(prices.data(), begin, end);
+      });
+    }
+    Valuation total;
+    for (unsigned t = 0; t < threads; ++t) {
+      workers[t].join();
+      total.market_value += partial[t].market_value;
+      total.cost += partial[t].cost;
+      total.pnl += partial[t].pnl;
+      for (size_t k = 0; k < kTypes; ++k) total.exposure[k] += partial[t].exposure[k];
+    }
+    return total;
+  }
+
+ private:
+  struct Columns {
+    std::vector<TickerId> ids;
+    std::vector<double> quantity;
+    std::vector<double> cost;  // cost basis per unit
+  };
+
+  // Positions [begin, end) of all types, counted type after type
+  Valuation RevalueRange(const double *prices, size_t begin, size_t end) const {
+    Valuation result;
+    size_t offset = 0;
+    for (size_t k = 0; k < kTypes; ++k) {
+      size_t n = m_columns[k].ids.size();
+      size_t first = std::max(begin, offset), last = std::min(end, offset + n);
+      if (first < last) {
+        double value = 0, paid = 0;
+        Sum(m_columns[k], prices, first - offset, last - offset, value, paid);
+        result.market_value += value;
+        result.cost += paid;
+        result.exposure[k] = value;
+      }
+      offset += n;
+    }
+    result.pnl = result.market_value - result.cost;
+    return result;
+  }
+
+  // Prices are gathered into a small block first; the sums over the block
+  // then have no indexed loads and no branches, and kLanes independent
+  // accumulators let the compiler keep them in vector registers without
+  // reassociating the math.
+  static void Sum(const Columns &columns, const double *prices, size_t begin,
+                  size_t end, double &value, double &paid) {
+    constexpr size_t kBlock = 256, kLanes = 4;
+    double price[kBlock];
+    double v[kLanes] = {}, p[kLanes] = {};
+    for (size_t block = begin; block < end; block += kBlock) {
+      size_t n = std::min(kBlock, end - block);
+      const TickerId *ids = columns.ids.data() + block;
+      const double *quantity = columns.quantity.data() + block;
+      const double *cost = columns.cost.data() + block;
+      for (size_t i = 0; i < n; ++i) price[i] = prices[ids[i]];
+      size_t i = 0;
+      for (; i + kLanes <= n; i += kLanes) {
+        for (size_t l = 0; l < kLanes; ++l) {
+          v[l] += quantity[i + l] * price[i + l];
+          p[l] += quantity[i + l] * cost[i + l];
+        }
+      }
+      for (; i < n; ++i) {
+        v[0] += quantity[i] * price[i];
+        p[0] += quantity[i] * cost[i];
+      }
+    }
+    for (size_t l = 0; l < kLanes; ++l) {
+      value += v[l];
+      paid += p[l];
+    }
+  }
+
+  Columns m_columns[kTypes];  // by Investment_Type
+};
+
+// Measurements printed by main(); sizes are kept small so the demo stays quick
+template <typename Body>
+double NanosPerOp(size_t ops, Body &&body) {
+  auto start = std::chrono::steady_clock::now();
+  body();
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start)
+             .count() /
+         ops;
+}
+
+// Replays a synthetic stream of limit orders around a fixed mid price, so
+// about half of them cross and the rest rest on the book. Throughput is
+// measured with batches of kBatch orders; latency by timing single orders.
+void ReplayOrderStream(size_t count) {
+  constexpr size_t kBatch = 256;
+  constexpr int kMid = 50000;
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> offset(-20, 20), quantity(1, 100), side(0, 1);
+  std::vector<Order> stream(count);
+  for (Order &order : stream)
+    order = Order{0, side(rng) ? Side::buy : Side::sell, kMid + offset(rng),
+                  static_cast<uint32_t>(quantity(rng))};
+
+  ExecutionEngine engine;
+  TickerId ticker = TradingFactory::Intern("SYNTH");
+  std::vector<Fill> fills;
+  fills.reserve(16 * kBatch);
+  size_t half = count / 2;
+  double batched_ns = NanosPerOp(half, [&] {
+    for (size_t i = 0; i < half; i += kBatch) {
+      engine.Submit(ticker, stream.data() + i, std::min(kBatch, half - i), fills);
+      fills.clear();
+    }
+  });
+
+  std::vector<double> latency;
+  latency.reserve(count - half);
+  for (size_t i = half; i < count; ++i) {
+    latency.push_back(NanosPerOp(1, [&] { engine.Submit(ticker, &stream[i], 1, fills); }));
+    fills.clear();
+  }
+  std::sort(latency.begin(), latency.end());
+  std::cout << count << " synthetic orders: " << 1e3 / batched_ns
+            << " M orders/s batched, matching latency p50 "
+            << latency[latency.size() / 2] << " ns, p99 "
+            << latency[latency.size() * 99 / 100] << " ns" << std::endl;
+}
+
+// Cached MakeInvestment lookups over `tickers` distinct tickers, 100k lookups
+// per row split over 1 to 32 threads
+void PrintLookupRate(size_t tickers) {
+  constexpr size_t kLookups = 100000;
+  std::vector<std::string> names(tickers);
+  for (size_t i = 0; i < tickers; ++i) {
+    names[i] = "T" + std::to_string(tickers) + "_" + std::to_string(i);
+    TradingFactory::MakeInvestment(Investment_Type::stock, names[i]);
+  }
+  std::cout << tickers << " tickers, M lookups/s:";
+  for (unsigned threads = 1; threads <= 32; threads *= 2) {
+    double ns = NanosPerOp(kLookups, [&] {
+      std::vector<std::thread> workers;
+      for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+          std::mt19937 rng(t);
+          std::uniform_int_distribution<size_t> pick(0, tickers - 1);
+          for (size_t i = 0; i < kLookups / threads; ++i)
+            TradingFactory::MakeInvestment(Investment_Type::stock, names[pick(rng)]);
+        });
+      }
+      for (std::thread &worker : workers) worker.join();
+    });
+    std::cout << " " << threads << "T " << 1e3 / ns;
+  }
+  std::cout << std::endl;
+}
+
+// The Buy log line written with std::endl per call against the async
+// logger, both into /dev/null. Hot-path cost is timed in bursts that fit the
+// logger's ring; end to end includes waiting for the writer thread.
+void PrintLogCost() {
+  constexpr size_t kBurst = 2048, kBursts = 100, kRecords = kBurst * kBursts;
+  const std::string sticker = "AAPL";
+  std::ofstream sink("/dev/null");
+  double endl_ns = NanosPerOp(kRecords, [&] {
+    for (size_t i = 0; i < kRecords; ++i)
+      sink << "buying " << sticker << " with price: " << 200 << std::endl;
+  });
+
+  FILE *null_file = std::fopen("/dev/null", "w");
+  double hot_ns = 0, total_ns = 0;
+  {
+    AsyncLogger logger(null_file);
+    total_ns = NanosPerOp(kRecords, [&] {
+      for (size_t burst = 0; burst < kBursts; ++burst) {
+        hot_ns += NanosPerOp(kRecords, [&] {
+          for (size_t i = 0; i < kBurst; ++i)
+            logger.Log("buying ", sticker, " with price: ", 200);
+        });
+        logger.Flush();
+      }
+    });
+  }
+  std::fclose(null_file);
+  std::cout << "ns per log line: std::endl " << endl_ns << ", async logger "
+            << hot_ns << " on the caller, " << total_ns << " end to end" << std::endl;
+}
+
+// Revaluations of a portfolio of `positions` spread over 1000 tickers and
+// all three instrument types, on one thread and on every core
+void PrintRevalueRate(size_t positions) {
+  constexpr size_t kTickers = 1000, kPasses = 20;
+  std::vector<std::string> names(kTickers);
+  TickerId last = 0;
+  for (size_t i = 0; i < kTickers; ++i) {
+    names[i] = "P" + std::to_string(i);
+    last = std::max(last, TradingFactory::Intern(names[i]));
+  }
+  Portfolio portfolio;
+  for (size_t i = 0; i < positions; ++i)
+    portfolio.Add(static_cast<Investment_Type>(i % 3), names[i % kTickers],
+                  static_cast<double>(i % 100 + 1), 100.0);
+  std::vector<double> prices(last + 1, 101.0);
+
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  double pnl = 0;
+  double single_ns = NanosPerOp(positions * kPasses, [&] {
+    for (size_t pass = 0; pass < kPasses; ++pass) pnl += portfolio.Revalue(prices, 1).pnl;
+  });
+  double parallel_ns = NanosPerOp(positions * kPasses, [&] {
+    for (size_t pass = 0; pass < kPasses; ++pass) pnl -= portfolio.Revalue(prices, cores).pnl;
+  });
+  std::cout << positions << " positions, M revalued/s: 1 thread " << 1e3 / single_ns
+            << ", " << cores << " threads " << 1e3 / parallel_ns
+            << (pnl == 0 ? "" : " (results differ)") << std::endl;
+}
+
 int main() {
     
-  std::unique_ptr<IFInvestment> ptr = TradingFactory::MakeInvestment(Investment_Type::stock, "AAPL");
+  std::shared_ptr<IFInvestment> ptr = TradingFactory::MakeInvestment(Investment_Type::stock, "AAPL");
   ptr->Buy(200);
+  AsyncLogger::Instance().Flush();
+  if (TradingFactory::MakeInvestment(Investment_Type::stock, "AAPL") == ptr)
+    std::cout << "AAPL served from the instrument cache" << std::endl;
+
+  // Orders for one ticker matched in a batch against its book
+  ExecutionEngine engine;
+  std::vector<Order> batch = {{0, Side::sell, 201, 100},
+                              {0, Side::sell, 202, 50},
+                              {0, Side::buy, 202, 120}};
+  std::vector<Fill> fills;
+  engine.Submit(TradingFactory::Intern("AAPL"), batch.data(), batch.size(), fills);
+  for (const Fill &fill : fills)
+    std::cout << "filled " << fill.quantity << " @ " << fill.price << std::endl;
+
+  // Mark-to-market of many positions against one price vector
+  Portfolio portfolio;
+  portfolio.Add(Investment_Type::stock, "AAPL", 100, 190.0);
+  portfolio.Add(Investment_Type::bond, "UST10Y", 50, 98.5);
+  portfolio.Add(Investment_Type::real_estate, "REIT1", 10, 1200.0);
+  std::vector<double> prices(3);
+  prices[TradingFactory::Intern("AAPL")] = 201.0;
+  prices[TradingFactory::Intern("UST10Y")] = 97.0;
+  prices[TradingFactory::Intern("REIT1")] = 1250.0;
+  Valuation valuation = portfolio.Revalue(prices, std::thread::hardware_concurrency());
+  std::cout << "portfolio value " << valuation.market_value << ", P&L "
+            << valuation.pnl << std::endl;
+
+  ReplayOrderStream(2000000);
+  PrintLookupRate(10000);
+  PrintLookupRate(1000000);
+  PrintLogCost();
+  PrintRevalueRate(4000000);
 
   return 0;
 }
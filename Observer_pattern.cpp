@@ -0,0 +1,474 @@
+/* Observer is a behavioral design pattern that lets you define a subscription mechanism to notify
+multiple objects about events that happen to the object they are observing.
+Here it is a typed publish/subscribe bus: each event type has its own Topic, and subjects (a
+device, a TCP connection, a trade) publish to it without knowing who listens.
+Pros: publishers and subscribers don't depend on each other, subscribers can come and go at runtime.
+Cons: subscribers are notified in no guaranteed order relative to other topics,
+      a slow synchronous subscriber slows down the publisher.
+
+Publishing never locks or allocates once the thread has published before. The subscriber list of a topic is a contiguous array that is
+replaced as a whole when someone subscribes or unsubscribes (also from inside a Notify), and
+the old array is handed to Epoch.h, which frees it once no publisher reads it any more.
+Synchronous subscribers are called on the publishing thread. Asynchronous subscribers get their own
+single-producer/single-consumer queue that a dispatcher thread drains, handing them whole batches.
+Because the queues are single-producer, a topic with asynchronous subscribers must be published
+from one thread at a time.
+Useful link: https://refactoring.guru/design-patterns/observer
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+#include "Epoch.h"
+
+//Observer interface, events are delivered in batches
+template <typename Event>
+class Subscriber {
+    public:
+        virtual ~Subscriber() = default;
+        virtual void Notify(const Event* events, size_t count) = 0;
+};
+
+enum class eDELIVERY {
+    SYNC,   // called on the publishing thread
+    ASYNC   // queued and called on the dispatcher thread
+};
+
+//Bounded single-producer/single-consumer ring of events
+template <typename Event>
+class EventRing {
+    public:
+        explicit EventRing(size_t capacity)
+        :m_mask(RoundUp(capacity) - 1), m_events(new Event[m_mask + 1]) {}
+
+        // Returns how many of the events fit
+        size_t Push(const Event* events, size_t count) {
+            size_t tail = m_tail.load(std::memory_order_relaxed);
+            size_t room = m_mask + 1 - (tail - m_head.load(std::memory_order_acquire));
+            size_t n = count < room ? count : room;
+            for(size_t i = 0; i < n; ++i)
+                m_events[(tail + i) & m_mask] = events[i];
+            m_tail.store(tail + n, std::memory_order_release);
+            return n;
+        }
+
+        // Position just past the last event pushed so far
+        size_t Tail() const { return m_tail.load(std::memory_order_acquire); }
+
+        // True once every event up to tail has been delivered
+        bool DrainedTo(size_t tail) const { return m_head.load(std::memory_order_acquire) >= tail; }
+
+        // Hands at most max queued events to deliver(events, count), straight from the ring
+        template <typename Deliver>
+        size_t Drain(size_t max, Deliver&& deliver) {
+            size_t head = m_head.load(std::memory_order_relaxed);
+            size_t available = m_tail.load(std::memory_order_acquire) - head;
+            size_t n = available < max ? available : max;
+            size_t first = head & m_mask;
+            size_t span = n < m_mask + 1 - first ? n : m_mask + 1 - first;
+            if(span > 0)
+                deliver(&m_events[first], span);
+            if(n > span)
+                deliver(&m_events[0], n - span);
+            m_head.store(head + n, std::memory_order_release);
+            return n;
+        }
+
+    private:
+        static size_t RoundUp(size_t n) {
+            size_t capacity = 2;
+            while(capacity < n)
+                capacity <<= 1;
+            return capacity;
+        }
+
+        const size_t m_mask;
+        std::unique_ptr<Event[]> m_events;
+        alignas(64) std::atomic<size_t> m_head{0};  // advanced by the dispatcher
+        alignas(64) std::atomic<size_t> m_tail{0};  // advanced by the publisher
+};
+
+//Queue of one asynchronous subscriber, as seen by the dispatcher
+class AsyncChannel {
+    public:
+        virtual ~AsyncChannel() = default;
+        // Delivers up to max events, returns how many
+        virtual size_t Deliver(size_t max) = 0;
+
+        std::atomic<bool> closed{false};  // set on unsubscribe
+};
+
+template <typename Event>
+class TypedChannel : public AsyncChannel {
+    public:
+        TypedChannel(Subscriber<Event>* subscriber, size_t capacity)
+        :m_subscriber(subscriber), m_ring(capacity) {}
+
+        // Waits for room unless the subscriber has gone away
+        void Push(const Event* events, size_t count) {
+            for(;;) {
+                size_t pushed = m_ring.Push(events, count);
+                events += pushed;
+                count -= pushed;
+                if(count == 0 || closed.load(std::memory_order_acquire))
+                    return;
+                std::this_thread::yield();
+            }
+        }
+
+        size_t Deliver(size_t max) override {
+            if(closed.load(std::memory_order_acquire))
+                return m_ring.Drain(SIZE_MAX, [](const Event*, size_t) {});
+            return m_ring.Drain(max, [this](const Event* events, size_t count) {
+                m_subscriber->Notify(events, count);
+            });
+        }
+
+        EventRing<Event>& Ring() { return m_ring; }
+
+    private:
+        Subscriber<Event>* m_subscriber;
+        EventRing<Event> m_ring;
+};
+
+//Background thread serving all asynchronous subscribers of a bus
+class Dispatcher {
+    public:
+        static constexpr size_t kBatch = 256;  // most events handed over per Notify
+
+        Dispatcher() {
+            m_thread = std::thread(&Dispatcher::Run, this);
+        }
+
+        ~Dispatcher() {
+            m_stop.store(true, std::memory_order_release);
+            m_thread.join();
+        }
+
+        Dispatcher(const Dispatcher&) = delete;
+        Dispatcher& operator=(const Dispatcher&) = delete;
+
+        void Add(std::shared_ptr<AsyncChannel> channel) {
+            std::lock_guard<std::mutex> lock(m_pendingLock);
+            m_pending.push_back(std::move(channel));
+        }
+
+        // Waits for a full pass over all channels; must not be called from a Notify
+        void Synchronize() {
+            uint64_t pass = m_passes.load(std::memory_order_acquire);
+            while(m_passes.load(std::memory_order_acquire) < pass + 2)
+                std::this_thread::yield();
+        }
+
+    private:
+        void Run() {
+            std::vector<std::shared_ptr<AsyncChannel>> channels;  // dispatcher thread only
+            for(;;) {
+                bool stopping = m_stop.load(std::memory_order_acquire);
+                {
+                    std::lock_guard<std::mutex> lock(m_pendingLock);
+                    for(auto& channel : m_pending)
+                        channels.push_back(std::move(channel));
+                    m_pending.clear();
+                }
+                size_t delivered = 0;
+                for(size_t i = 0; i < channels.size(); ) {
+                    delivered += channels[i]->Deliver(kBatch);
+                    if(channels[i]->closed.load(std::memory_order_acquire)) {
+                        channels[i] = std::move(channels.back());
+                        channels.pop_back();
+                    }
+                    else
+                        ++i;
+                }
+                m_passes.fetch_add(1, std::memory_order_release);
+                if(stopping && delivered == 0)
+                    return;
+                if(delivered == 0)
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+
+        std::mutex m_pendingLock;  // never taken by publishers
+        std::vector<std::shared_ptr<AsyncChannel>> m_pending;
+        std::atomic<bool> m_stop{false};
+        std::atomic<uint64_t> m_passes{0};
+        std::thread m_thread;
+};
+
+class TopicBase {
+    public:
+        virtual ~TopicBase() = default;
+};
+
+template <typename Event>
+class Topic : public TopicBase {
+    static_assert(std::is_copy_assignable<Event>::value && std::is_default_constructible<Event>::value,
+                  "events are copied into subscriber queues");
+
+    public:
+        using SubscriptionId = uint64_t;
+
+        explicit Topic(Dispatcher& dispatcher)
+        :m_dispatcher(dispatcher), m_current(new Snapshot()) {}
+
+        ~Topic() {
+            for(auto& channel : m_channels)
+                channel.second->closed.store(true, std::memory_order_release);
+            delete m_current.load();
+        }
+
+        Topic(const Topic&) = delete;
+        Topic& operator=(const Topic&) = delete;
+
+        // Takes effect for the next Publish; safe to call from inside a Notify
+        SubscriptionId Subscribe(Subscriber<Event>* subscriber, eDELIVERY delivery = eDELIVERY::SYNC,
+                                 size_t queueCapacity = 1024) {
+            std::lock_guard<std::mutex> lock(m_writer);
+            SubscriptionId id = ++m_lastId;
+            Entry entry{id, subscriber, nullptr};
+            if(delivery == eDELIVERY::ASYNC) {
+                auto channel = std::make_shared<TypedChannel<Event>>(subscriber, queueCapacity);
+                entry.channel = channel;
+                m_channels.emplace(id, channel);
+                m_dispatcher.Add(std::move(channel));
+            }
+            Snapshot* next = new Snapshot(*m_current.load());
+            next->entries.push_back(entry);
+            Swap(next);
+            return id;
+        }
+
+        /* Safe to call from inside a Notify. A dispatch already running may still reach the
+           subscriber; call Synchronize() (outside any Notify) before destroying it. */
+        bool Unsubscribe(SubscriptionId id) {
+            std::lock_guard<std::mutex> lock(m_writer);
+            const Snapshot* current = m_current.load();
+            Snapshot* next = new Snapshot();
+            next->entries.reserve(current->entries.size());
+            for(const Entry& entry : current->entries)
+                if(entry.id != id)
+                    next->entries.push_back(entry);
+            if(next->entries.size() == current->entries.size()) {
+                delete next;
+                return false;
+            }
+            auto channel = m_channels.find(id);
+            if(channel != m_channels.end()) {
+                // snapshots still in use keep the queue alive until they are reclaimed
+                channel->second->closed.store(true, std::memory_order_release);
+                m_channels.erase(channel);
+            }
+            Swap(next);
+            return true;
+        }
+
+        void Publish(const Event& event) {
+            Publish(&event, 1);
+        }
+
+        // Synchronous subscribers get the whole batch in one Notify
+        void Publish(const Event* events, size_t count) {
+            Epoch::Guard guard;
+            const Snapshot* snapshot = m_current.load();
+            for(const Entry& entry : snapshot->entries) {
+                if(entry.channel != nullptr)
+                    entry.channel->Push(events, count);
+                else
+                    entry.subscriber->Notify(events, count);
+            }
+        }
+
+        /* Returns once everything published before the call has been delivered and no dispatch
+           that started before it is still running. Must not be called from a Notify. */
+        void Synchronize() {
+            Epoch::Synchronize();
+            std::vector<std::pair<std::shared_ptr<TypedChannel<Event>>, size_t>> pending;
+            {
+                std::lock_guard<std::mutex> lock(m_writer);
+                for(auto& channel : m_channels)
+                    pending.emplace_back(channel.second, channel.second->Ring().Tail());
+            }
+            for(auto& channel : pending)
+                while(!channel.first->Ring().DrainedTo(channel.second))
+                    std::this_thread::yield();
+            m_dispatcher.Synchronize();
+        }
+
+    private:
+        struct Entry {
+            SubscriptionId id;
+            Subscriber<Event>* subscriber;
+            std::shared_ptr<TypedChannel<Event>> channel;  // null for synchronous delivery
+        };
+
+        struct Snapshot {
+            std::vector<Entry> entries;
+        };
+
+        // Caller holds m_writer
+        void Swap(const Snapshot* next) {
+            Epoch::Retire(m_current.exchange(next));
+        }
+
+        Dispatcher& m_dispatcher;
+        std::atomic<const Snapshot*> m_current;
+        std::mutex m_writer;  // serializes subscription changes, never taken by Publish
+        SubscriptionId m_lastId = 0;
+        std::unordered_map<SubscriptionId, std::shared_ptr<TypedChannel<Event>>> m_channels;
+};
+
+//One topic per event type
+class EventBus {
+    public:
+        // Look the topic up once and keep the reference: the lookup takes a lock
+        template <typename Event>
+        Topic<Event>& On() {
+            std::lock_guard<std::mutex> lock(m_lock);
+            auto& topic = m_topics[std::type_index(typeid(Event))];
+            if(!topic)
+                topic = std::make_unique<Topic<Event>>(m_dispatcher);
+            return static_cast<Topic<Event>&>(*topic);
+        }
+
+    private:
+        std::mutex m_lock;
+        std::unordered_map<std::type_index, std::unique_ptr<TopicBase>> m_topics;
+        Dispatcher m_dispatcher;  // declared last: stops before the topics go
+};
+
+//Events of the other examples
+struct DeviceSwitched {
+    int slot;
+    bool on;
+};
+
+struct ConnectionStateChanged {
+    int from;
+    int to;
+};
+
+struct TradeExecuted {
+    uint32_t ticker;
+    int quantity;
+    int price;
+};
+
+class TradeVolume : public Subscriber<TradeExecuted> {
+    public:
+        void Notify(const TradeExecuted* trades, size_t count) override {
+            for(size_t i = 0; i < count; ++i)
+                m_volume.fetch_add(trades[i].quantity, std::memory_order_relaxed);
+        }
+        long Volume() const { return m_volume.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<long> m_volume{0};
+};
+
+class DevicePrinter : public Subscriber<DeviceSwitched> {
+    public:
+        void Notify(const DeviceSwitched* events, size_t count) override {
+            for(size_t i = 0; i < count; ++i)
+                std::cout << "slot " << events[i].slot << (events[i].on ? " on" : " off") << "\n";
+        }
+};
+
+//Leaves the topic from inside its first notification
+class FirstConnectionOnly : public Subscriber<ConnectionStateChanged> {
+    public:
+        explicit FirstConnectionOnly(Topic<ConnectionStateChanged>& topic)
+        :m_topic(topic), m_id(topic.Subscribe(this)) {}
+
+        void Notify(const ConnectionStateChanged* events, size_t) override {
+            std::cout << "first transition " << events[0].from << " -> " << events[0].to << "\n";
+            m_topic.Unsubscribe(m_id);
+        }
+
+    private:
+        Topic<ConnectionStateChanged>& m_topic;
+        Topic<ConnectionStateChanged>::SubscriptionId m_id;
+};
+
+//Counts what it receives; each counter is only touched by one thread
+class EventCount : public Subscriber<TradeExecuted> {
+    public:
+        void Notify(const TradeExecuted*, size_t count) override { m_count += count; }
+        size_t Count() const { return m_count; }
+
+    private:
+        size_t m_count = 0;
+};
+
+/* Events published per second with 1 to maxSubscribers subscribers on one topic, in batches of 64.
+Each row delivers about 4M events in total; asynchronous rows include waiting for the dispatcher. */
+void PrintFanOut(eDELIVERY delivery, size_t maxSubscribers)
+{
+    const size_t kBatch = 64, kDeliveries = 4000000;
+    TradeExecuted batch[kBatch];
+    for(size_t i = 0; i < kBatch; ++i)
+        batch[i] = {1, 10, 200};
+    std::cout << (delivery == eDELIVERY::SYNC ? "sync" : "async") << " fan-out, M events/s:";
+    for(size_t subscribers = 1; subscribers <= maxSubscribers; subscribers *= 10) {
+        EventBus bus;
+        auto& topic = bus.On<TradeExecuted>();
+        std::vector<EventCount> counters(subscribers);
+        for(auto& counter : counters)
+            topic.Subscribe(&counter, delivery);
+        size_t rounds = std::max<size_t>(1, kDeliveries / subscribers / kBatch);
+        auto start = std::chrono::steady_clock::now();
+        for(size_t round = 0; round < rounds; ++round)
+            topic.Publish(batch, kBatch);
+        topic.Synchronize();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        for(const auto& counter : counters)
+            if(counter.Count() != rounds * kBatch)
+                std::cout << " (lost events)";
+        std::cout << " " << subscribers << " subs " << rounds * kBatch / seconds / 1e6;
+    }
+    std::cout << "\n";
+}
+
+int main()
+{
+    EventBus bus;
+
+    DevicePrinter printer;
+    auto& devices = bus.On<DeviceSwitched>();
+    devices.Subscribe(&printer);
+    devices.Publish({1, true});
+
+    FirstConnectionOnly once(bus.On<ConnectionStateChanged>());
+    auto& connections = bus.On<ConnectionStateChanged>();
+    connections.Publish({0, 1});
+    connections.Publish({1, 2});  // nobody listens any more
+
+    TradeVolume volume;
+    auto& trades = bus.On<TradeExecuted>();
+    auto id = trades.Subscribe(&volume, eDELIVERY::ASYNC);
+    TradeExecuted batch[64];
+    for(int i = 0; i < 64; ++i)
+        batch[i] = {1, 10, 200 + i};
+    for(int round = 0; round < 100; ++round)
+        trades.Publish(batch, 64);
+    trades.Synchronize();
+    std::cout << "traded volume: " << volume.Volume() << "\n";
+    trades.Unsubscribe(id);
+    trades.Synchronize();
+
+    PrintFanOut(eDELIVERY::SYNC, 10000);
+    PrintFanOut(eDELIVERY::ASYNC, 1000);
+
+    return 0;
+}
@@ -8,8 +8,30 @@ types directly.
 Useful link: http://www.vincehuston.org/dp/proxy.html 
 */
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fcntl.h>
+#include <future>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <sys/file.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include "AsyncLogger.h"
 
 using namespace std;
 
@@ -20,58 +42,762 @@ class Payment
 };
 
 //Real object
+/* The balance is split over per-core sub-balances, each on its own cache line, so payments from
+different threads don't contend on one atomic. A debit is a CAS on the caller's sub-balance; only
+when that runs short are all sub-balances gathered (under a lock) to decide the overdraft check
+and spread out again. The sum of the sub-balances is the one authoritative balance. */
 class FundAccount : public Payment
 {
     public:
         FundAccount(const unsigned int balance)
-        :m_balance(balance) {}
+        {
+            Spread(balance);
+        }
         FundAccount() = default;
         ~FundAccount() = default;
         
         void Pay(const unsigned int amount) override
         {
-            if(m_balance > amount)
-                m_balance = m_balance - amount;
-            std::cout << "Payment is completed, your account balance is: " << m_balance << std::endl;
+            if(TryPay(amount))
+                AsyncLogger::Instance().Log("Payment is completed, your account balance is: ", Balance());
+            else
+                AsyncLogger::Instance().Log("Unable to pay, pls topup your account");
+        }
+
+        // Debits amount unless that would overdraw the account
+        bool TryPay(const unsigned int amount)
+        {
+            std::atomic<unsigned int> &local = m_shards[LocalShard()].balance;
+            unsigned int current = local.load(std::memory_order_relaxed);
+            while(current >= amount)
+            {
+                if(local.compare_exchange_weak(current, current - amount, std::memory_order_acq_rel))
+                    return true;
+            }
+            return Rebalance(amount);
+        }
+
+        void Deposit(const unsigned int amount)
+        {
+            m_shards[LocalShard()].balance.fetch_add(amount, std::memory_order_acq_rel);
+        }
+
+        // Exact when no payment is in flight
+        unsigned int Balance() const
+        {
+            unsigned int total = 0;
+            for(const auto &shard : m_shards)
+                total += shard.balance.load(std::memory_order_acquire);
+            return total;
         }
         
     private:
-        unsigned int m_balance;
+        static constexpr unsigned int kShards = 16;
+
+        struct alignas(64) Shard
+        {
+            std::atomic<unsigned int> balance{0};
+        };
+
+        static unsigned int LocalShard()
+        {
+            static std::atomic<unsigned int> next{0};
+            thread_local unsigned int shard = next.fetch_add(1, std::memory_order_relaxed) % kShards;
+            return shard;
+        }
+
+        // Slow path: collect every sub-balance, decide, then hand the rest back out
+        bool Rebalance(const unsigned int amount)
+        {
+            std::lock_guard<std::mutex> lock(m_rebalance);
+            unsigned int total = 0;
+            for(auto &shard : m_shards)
+                total += shard.balance.exchange(0, std::memory_order_acq_rel);
+            bool paid = total >= amount;
+            if(paid)
+                total -= amount;
+            Spread(total);
+            return paid;
+        }
+
+        void Spread(const unsigned int total)
+        {
+            for(unsigned int i = 0; i < kShards; ++i)
+                m_shards[i].balance.fetch_add(total / kShards + (i < total % kShards), std::memory_order_acq_rel);
+        }
+
+        Shard m_shards[kShards];
+        std::mutex m_rebalance;
+};
+
+/* Group commit for payments. Submitted payments queue up until the batch is full or the batch
+window has passed; the committer thread then debits them in submission order, appends one record
+per accepted payment to the journal with a single write() and makes it durable with a single
+fdatasync(). Futures complete only after the batch is on disk. If the journal write fails, the
+journal is cut back to where the batch started, the batch is refunded and every payment in it
+fails with the error. Records carry the account id; sequence numbers continue from the last
+record already in the journal, and a torn record left by a crash is dropped on open. */
+class PaymentBatcher
+{
+    public:
+        struct Options
+        {
+            size_t maxBatch = 256;
+            std::chrono::microseconds window{200};
+        };
+
+        // Empty journalPath: batches are applied but not persisted. A journal belongs to one
+        // batcher at a time, in this process or any other; opening one that is in use throws.
+        PaymentBatcher(FundAccount &account, uint32_t accountId, const std::string &journalPath,
+                       Options options)
+        :m_account(account), m_accountId(accountId), m_options(options)
+        {
+            if(!journalPath.empty())
+            {
+                m_journal = ::open(journalPath.c_str(), O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+                if(m_journal < 0)
+                    throw std::system_error(errno, std::generic_category(), "open " + journalPath);
+                try
+                {
+                    // Held until close; a second writer would reuse sequences and could
+                    // truncate records this one already acknowledged
+                    if(::flock(m_journal, LOCK_EX | LOCK_NB) != 0)
+                        throw std::system_error(errno, std::generic_category(), "journal in use " + journalPath);
+                    Resume();
+                }
+                catch(...)
+                {
+                    ::close(m_journal);
+                    throw;
+                }
+            }
+            m_committer = std::thread(&PaymentBatcher::Run, this);
+        }
+
+        // Commits everything already submitted before returning
+        ~PaymentBatcher()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+                m_stop = true;
+            }
+            m_wake.notify_one();
+            m_committer.join();
+            if(m_journal >= 0)
+                ::close(m_journal);
+        }
+
+        PaymentBatcher(const PaymentBatcher &) = delete;
+        PaymentBatcher &operator=(const PaymentBatcher &) = delete;
+
+        std::future<bool> Submit(const unsigned int amount)
+        {
+            std::promise<bool> done;
+            std::future<bool> result = done.get_future();
+            bool wake;
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+                m_pending.push_back({amount, std::move(done)});
+                // the first payment opens the window, a full batch closes it
+                wake = m_pending.size() == 1 || m_pending.size() >= m_options.maxBatch;
+            }
+            if(wake)
+                m_wake.notify_one();
+            return result;
+        }
+
+    private:
+        struct Pending
+        {
+            unsigned int amount;
+            std::promise<bool> done;
+        };
+
+        // On-disk journal record, one per accepted payment
+        struct Record
+        {
+            uint64_t sequence;
+            uint32_t account;
+            uint32_t amount;
+        };
+
+        // Drops a torn tail record and continues numbering after the last whole one
+        void Resume()
+        {
+            off_t size = ::lseek(m_journal, 0, SEEK_END);
+            if(size < 0)
+                throw std::system_error(errno, std::generic_category(), "journal seek");
+            off_t whole = size - size % off_t(sizeof(Record));
+            if(whole != size && ::ftruncate(m_journal, whole) != 0)
+                throw std::system_error(errno, std::generic_category(), "journal truncate");
+            m_end = whole;
+            if(whole == 0)
+                return;
+            Record last;
+            if(::pread(m_journal, &last, sizeof(last), whole - off_t(sizeof(Record))) != ssize_t(sizeof(last)))
+                throw std::system_error(errno, std::generic_category(), "journal read");
+            m_sequence = last.sequence + 1;
+        }
+
+        void Run()
+        {
+            std::vector<Pending> batch;
+            std::vector<Record> records;
+            std::vector<char> accepted;
+            for(;;)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(m_lock);
+                    m_wake.wait(lock, [this] { return m_stop || !m_pending.empty(); });
+                    if(m_pending.empty())
+                        return;
+                    // Give the batch until the window closes to fill up
+                    m_wake.wait_for(lock, m_options.window,
+                                    [this] { return m_stop || m_pending.size() >= m_options.maxBatch; });
+                    batch.swap(m_pending);
+                }
+                Commit(batch, records, accepted);
+                batch.clear();
+            }
+        }
+
+        void Commit(std::vector<Pending> &batch, std::vector<Record> &records, std::vector<char> &accepted)
+        {
+            records.clear();
+            accepted.assign(batch.size(), 0);
+            uint64_t first = m_sequence;
+            for(size_t i = 0; i < batch.size(); ++i)
+            {
+                if(m_account.TryPay(batch[i].amount))
+                {
+                    accepted[i] = 1;
+                    records.push_back({m_sequence++, m_accountId, batch[i].amount});
+                }
+            }
+            try
+            {
+                Persist(records);
+            }
+            catch(...)
+            {
+                m_sequence = first;
+                for(size_t i = 0; i < batch.size(); ++i)
+                {
+                    if(accepted[i])
+                        m_account.Deposit(batch[i].amount);
+                    batch[i].done.set_exception(std::current_exception());
+                }
+                return;
+            }
+            for(size_t i = 0; i < batch.size(); ++i)
+                batch[i].done.set_value(accepted[i] != 0);
+        }
+
+        void Persist(const std::vector<Record> &records)
+        {
+            if(m_journal < 0 || records.empty())
+                return;
+            if(m_damaged)
+                throw std::runtime_error("journal could not be rolled back after an earlier failure");
+            const char *data = reinterpret_cast<const char *>(records.data());
+            size_t size = records.size() * sizeof(Record);
+            size_t left = size;
+            while(left > 0)
+            {
+                ssize_t written = ::write(m_journal, data, left);
+                if(written < 0 && errno == EINTR)
+                    continue;
+                if(written < 0)
+                    Rollback("journal write");
+                data += written;
+                left -= written;
+            }
+            if(::fdatasync(m_journal) != 0)
+                Rollback("journal fdatasync");
+            m_end += off_t(size);
+        }
+
+        // Cuts off whatever part of the batch reached the journal, then reports the failure
+        [[noreturn]] void Rollback(const char *what)
+        {
+            int error = errno;
+            if(::ftruncate(m_journal, m_end) != 0 || ::fdatasync(m_journal) != 0)
+                m_damaged = true;  // refuse further batches rather than append after a torn one
+            throw std::system_error(error, std::generic_category(), what);
+        }
+
+        FundAccount &m_account;
+        uint32_t m_accountId;
+        Options m_options;
+        int m_journal = -1;
+        off_t m_end = 0;  // journal length after the last committed batch
+        bool m_damaged = false;
+        uint64_t m_sequence = 0;
+        std::mutex m_lock;
+        std::condition_variable m_wake;
+        std::vector<Pending> m_pending;
+        bool m_stop = false;
+        std::thread m_committer;
 };
 
 //Proxy object
 class ProxyCheck : public Payment
 {
     public:
-        ProxyCheck(const unsigned int balance)
-        :m_balance(balance){};
+        ProxyCheck(const unsigned int balance, const std::string &journalPath = "",
+                   const unsigned int accountId = 0,
+                   PaymentBatcher::Options batching = PaymentBatcher::Options())
+        :m_openingBalance(balance), m_accountId(accountId), m_journalPath(journalPath),
+         m_batching(batching){};
         ProxyCheck() = default;
         ~ProxyCheck() = default;
         
         void Pay(const unsigned int amount) override
         {
-            /*This is called lazy initialization, ProxyCheck is created but Real onject only created
-            when Pay method is invoked */
-            if(!m_realAccount)
-                m_realAccount = std::make_shared<FundAccount>(m_balance);
-            
-            if(m_balance > amount)
-                m_realAccount->Pay(amount);
-            else    
-                std::cout << "Unable to pay, pls topup your account" << std::endl;
+            // The proxy keeps no balance of its own: the real account decides
+            Account().Pay(amount);
+        }
+
+        bool TryPay(const unsigned int amount)
+        {
+            return Account().TryPay(amount);
+        }
+
+        // Queues the payment for the next group commit; the future tells whether it was accepted
+        std::future<bool> PayAsync(const unsigned int amount)
+        {
+            std::call_once(m_batcherCreated, [this] {
+                m_batcher = std::make_unique<PaymentBatcher>(Account(), m_accountId, m_journalPath,
+                                                             m_batching);
+            });
+            return m_batcher->Submit(amount);
         }
         
     private:
-        unsigned int m_balance;
+        /*This is called lazy initialization, ProxyCheck is created but Real onject only created
+        when a payment is made */
+        FundAccount &Account()
+        {
+            std::call_once(m_created, [this] { m_realAccount = std::make_shared<FundAccount>(m_openingBalance); });
+            return *m_realAccount;
+        }
+
+        unsigned int m_openingBalance = 0;
+        unsigned int m_accountId = 0;
+        std::string m_journalPath;
+        PaymentBatcher::Options m_batching;
+        std::once_flag m_created;
         std::shared_ptr<FundAccount> m_realAccount;
+        std::once_flag m_batcherCreated;
+        std::unique_ptr<PaymentBatcher> m_batcher;  // declared last: drains before the account goes
 };
 
+/* Caching proxy: memoizes results of an expensive real object behind the same interface.
+Interface must declare Key, Value and a virtual "Value Fetch(const Key&)". Entries live in a
+sharded CLOCK cache with a time-to-live; concurrent misses on one key share a single call to
+the real object. */
+template <typename Interface>
+class CachingProxy : public Interface
+{
+    public:
+        using Key = typename Interface::Key;
+        using Value = typename Interface::Value;
+        using Clock = std::chrono::steady_clock;
+
+        struct Stats
+        {
+            uint64_t hits;
+            uint64_t misses;     // calls that reached the real object
+            uint64_t coalesced;  // misses that waited on another caller's call
+        };
+
+        CachingProxy(std::shared_ptr<Interface> real, size_t capacity, Clock::duration ttl)
+        :m_real(std::move(real)), m_ttl(ttl)
+        {
+            size_t perShard = (capacity + kShards - 1) / kShards;
+            for(auto &shard : m_shards)
+                shard.Reserve(perShard ? perShard : 1);
+        }
+
+        Value Fetch(const Key &key) override
+        {
+            Shard &shard = ShardFor(key);
+            {
+                std::shared_lock<std::shared_mutex> lock(shard.lock);
+                if(const Slot *slot = shard.Find(key, Clock::now()))
+                    return Hit(*slot);
+            }
+            std::unique_lock<std::shared_mutex> lock(shard.lock);
+            if(const Slot *slot = shard.Find(key, Clock::now()))
+                return Hit(*slot);
+            auto pending = shard.inflight.find(key);
+            if(pending != shard.inflight.end())
+            {
+                std::shared_future<Value> result = pending->second.result;
+                lock.unlock();
+                m_coalesced.fetch_add(1, std::memory_order_relaxed);
+                return result.get();
+            }
+            std::promise<Value> promise;
+            uint64_t fetch = ++shard.lastFetch;
+            shard.inflight.emplace(key, Pending{promise.get_future().share(), fetch});
+            lock.unlock();
+            m_misses.fetch_add(1, std::memory_order_relaxed);
+            try
+            {
+                Value value = m_real->Fetch(key);
+                lock.lock();
+                // An Invalidate during the call removed our entry: the value may be stale
+                if(shard.Finish(key, fetch))
+                    shard.Insert(key, value, Clock::now() + m_ttl);
+                lock.unlock();
+                promise.set_value(value);
+                return value;
+            }
+            catch(...)
+            {
+                // Failures are not cached: waiters get the error, the next call retries
+                lock.lock();
+                shard.Finish(key, fetch);
+                lock.unlock();
+                promise.set_exception(std::current_exception());
+                throw;
+            }
+        }
+
+        /* Drops a cached value, e.g. after the real object changed it. A call already on its way
+           to the real object is not cached when it returns, and later callers don't wait for it. */
+        void Invalidate(const Key &key)
+        {
+            Shard &shard = ShardFor(key);
+            std::unique_lock<std::shared_mutex> lock(shard.lock);
+            shard.Erase(key);
+            shard.inflight.erase(key);
+        }
+
+        Stats GetStats() const
+        {
+            return {m_hits.load(std::memory_order_relaxed), m_misses.load(std::memory_order_relaxed),
+                    m_coalesced.load(std::memory_order_relaxed)};
+        }
+
+    private:
+        static constexpr size_t kShards = 32;
+
+        struct Slot
+        {
+            Key key;
+            Value value;
+            Clock::time_point expires;
+            bool used = false;
+            mutable std::atomic<bool> referenced{false};  // set by readers under the shared lock
+        };
+
+        struct Pending
+        {
+            std::shared_future<Value> result;
+            uint64_t fetch;  // tells a restarted fetch of the same key apart
+        };
+
+        // CLOCK replacement: the hand skips recently referenced slots once
+        struct Shard
+        {
+            std::shared_mutex lock;
+            std::unordered_map<Key, size_t> index;
+            std::unique_ptr<Slot[]> slots;
+            size_t capacity = 0;
+            size_t hand = 0;
+            std::unordered_map<Key, Pending> inflight;
+            uint64_t lastFetch = 0;
+
+            void Reserve(size_t n)
+            {
+                slots.reset(new Slot[n]);
+                capacity = n;
+                index.reserve(n);
+            }
+
+            const Slot *Find(const Key &key, Clock::time_point now) const
+            {
+                auto it = index.find(key);
+                if(it == index.end() || slots[it->second].expires <= now)
+                    return nullptr;
+                return &slots[it->second];
+            }
+
+            void Insert(const Key &key, const Value &value, Clock::time_point expires)
+            {
+                size_t pos;
+                auto it = index.find(key);
+                if(it != index.end())
+                    pos = it->second;
+                else
+                {
+                    Clock::time_point now = Clock::now();
+                    for(;;)
+                    {
+                        Slot &slot = slots[hand];
+                        if(!slot.used || slot.expires <= now ||
+                           !slot.referenced.exchange(false, std::memory_order_relaxed))
+                            break;
+                        hand = (hand + 1) % capacity;
+                    }
+                    pos = hand;
+                    hand = (hand + 1) % capacity;
+                    if(slots[pos].used)
+                        index.erase(slots[pos].key);
+                    index.emplace(key, pos);
+                }
+                Slot &slot = slots[pos];
+                slot.key = key;
+                slot.value = value;
+                slot.expires = expires;
+                slot.used = true;
+                slot.referenced.store(false, std::memory_order_relaxed);
+            }
+
+            // Removes the fetch's in-flight entry; false if Invalidate already did
+            bool Finish(const Key &key, uint64_t fetch)
+            {
+                auto it = inflight.find(key);
+                if(it == inflight.end() || it->second.fetch != fetch)
+                    return false;
+                inflight.erase(it);
+                return true;
+            }
+
+            void Erase(const Key &key)
+            {
+                auto it = index.find(key);
+                if(it == index.end())
+                    return;
+                slots[it->second].used = false;
+                index.erase(it);
+            }
+        };
+
+        Value Hit(const Slot &slot)
+        {
+            if(!slot.referenced.load(std::memory_order_relaxed))
+                slot.referenced.store(true, std::memory_order_relaxed);
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            return slot.value;
+        }
+
+        Shard &ShardFor(const Key &key)
+        {
+            // std::hash of integers is the identity, so mix before taking the top bits
+            uint64_t h = std::hash<Key>()(key) * 0x9E3779B97F4A7C15ull;
+            return m_shards[h >> 59];
+        }
+
+        std::shared_ptr<Interface> m_real;
+        Clock::duration m_ttl;
+        Shard m_shards[kShards];
+        std::atomic<uint64_t> m_hits{0};
+        std::atomic<uint64_t> m_misses{0};
+        std::atomic<uint64_t> m_coalesced{0};
+};
+
+//Expensive lookup we want to put behind a caching proxy
+class AccountDirectory
+{
+    public:
+        using Key = unsigned int;    // account id
+        using Value = unsigned int;  // balance
+        virtual ~AccountDirectory() = default;
+        virtual Value Fetch(const Key &account) = 0;
+};
+
+//Local stand-in for the remote directory, for tests and examples
+class LocalAccountDirectory : public AccountDirectory
+{
+    public:
+        LocalAccountDirectory(std::unordered_map<Key, Value> balances, std::chrono::microseconds latency)
+        :m_balances(std::move(balances)), m_latency(latency) {}
+
+        Value Fetch(const Key &account) override
+        {
+            m_calls.fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::sleep_for(m_latency);
+            auto it = m_balances.find(account);
+            if(it == m_balances.end())
+                throw std::out_of_range("unknown account");
+            return it->second;
+        }
+
+        uint64_t Calls() const { return m_calls.load(std::memory_order_relaxed); }
+
+    private:
+        const std::unordered_map<Key, Value> m_balances;
+        std::chrono::microseconds m_latency;
+        std::atomic<uint64_t> m_calls{0};
+};
+
+// Measurements printed by main(); sizes are kept small so the demo stays quick
+template <typename Body>
+double NanosPerOp(size_t ops, Body &&body)
+{
+    auto start = std::chrono::steady_clock::now();
+    body();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ops;
+}
+
+/* Fetches of 100k accounts drawn from a Zipfian distribution with the given skew, through a
+cache holding 10% of them. The stand-in directory answers without delay, so a miss costs
+the proxy's own bookkeeping plus the directory lookup. */
+void PrintZipfianCache(double skew)
+{
+    const unsigned int accounts = 100000;
+    const size_t fetches = 200000;
+    std::unordered_map<unsigned int, unsigned int> balances;
+    std::vector<double> weights(accounts);
+    for(unsigned int k = 0; k < accounts; ++k)
+    {
+        balances.emplace(k, k);
+        weights[k] = 1.0 / std::pow(k + 1, skew);
+    }
+    std::mt19937 rng(11);
+    std::discrete_distribution<unsigned int> zipf(weights.begin(), weights.end());
+    std::vector<unsigned int> keys(fetches);
+    for(auto &key : keys)
+        key = zipf(rng);
+
+    auto local = std::make_shared<LocalAccountDirectory>(std::move(balances), std::chrono::microseconds(0));
+    CachingProxy<AccountDirectory> directory(local, accounts / 10, std::chrono::seconds(60));
+    for(unsigned int key : keys)  // warm up
+        directory.Fetch(key);
+    auto before = directory.GetStats();
+    std::vector<double> latency;
+    latency.reserve(fetches);
+    for(unsigned int key : keys)
+        latency.push_back(NanosPerOp(1, [&] { directory.Fetch(key); }));
+    auto after = directory.GetStats();
+    std::sort(latency.begin(), latency.end());
+    double hitRate = double(after.hits - before.hits) / fetches;
+    cout << "zipf " << skew << ": hit rate " << hitRate * 100 << "%, fetch p50 "
+         << latency[fetches / 2] << " ns, p99 " << latency[fetches * 99 / 100] << " ns" << endl;
+}
+
+// 1M one-unit payments split over 1 to 64 threads, each row on a fresh account
+void PrintPaymentRate()
+{
+    const unsigned int payments = 1000000;
+    cout << "M payments/s:";
+    for(unsigned int threads = 1; threads <= 64; threads *= 2)
+    {
+        FundAccount account(2 * payments);
+        double ns = NanosPerOp(payments, [&] {
+            std::vector<std::thread> payers;
+            for(unsigned int t = 0; t < threads; ++t)
+                payers.emplace_back([&account, threads, payments] {
+                    for(unsigned int i = 0; i < payments / threads; ++i)
+                        account.TryPay(1);
+                });
+            for(auto &payer : payers)
+                payer.join();
+        });
+        cout << " " << threads << "T " << 1e3 / ns;
+    }
+    cout << endl;
+}
+
+/* Group commit trade-off: 16 clients each pay 50 times, waiting for every payment to be on disk
+before the next, against a journal in the working directory. Small batches pay for more
+fdatasync calls; long windows make each payment wait for the window to close. */
+void PrintBatchTradeoff()
+{
+    const char *journal = "payments_bench.journal";
+    const unsigned int clients = 16, perClient = 50;
+    for(size_t maxBatch : {size_t(1), size_t(16), size_t(256)})
+    {
+        for(auto window : {std::chrono::microseconds(100), std::chrono::microseconds(1000)})
+        {
+            ::unlink(journal);
+            std::vector<double> latency(clients * perClient);
+            double ns;
+            {
+                ProxyCheck account(clients * perClient, journal, 1, PaymentBatcher::Options{maxBatch, window});
+                ns = NanosPerOp(clients * perClient, [&] {
+                    std::vector<std::thread> payers;
+                    for(unsigned int c = 0; c < clients; ++c)
+                        payers.emplace_back([&account, &latency, c, perClient] {
+                            for(unsigned int i = 0; i < perClient; ++i)
+                                latency[c * perClient + i] = NanosPerOp(1, [&] { account.PayAsync(1).get(); });
+                        });
+                    for(auto &payer : payers)
+                        payer.join();
+                });
+            }
+            std::sort(latency.begin(), latency.end());
+            cout << "batch " << maxBatch << ", window " << window.count() << " us: "
+                 << 1e9 / ns << " payments/s, p50 " << latency[latency.size() / 2] / 1e3 << " us, p99 "
+                 << latency[latency.size() * 99 / 100] / 1e3 << " us" << endl;
+        }
+    }
+    ::unlink(journal);
+}
+
 int main()
 {
     
     ProxyCheck paycheck(1000);
     paycheck.Pay(50000);
     paycheck.Pay(500);
+
+    ProxyCheck batched(1000, "payments.journal");
+    std::vector<std::future<bool>> receipts;
+    for(unsigned int amount : {300, 300, 300, 300})
+        receipts.push_back(batched.PayAsync(amount));
+    for(auto &receipt : receipts)
+        cout << (receipt.get() ? "payment committed" : "payment declined") << endl;
+
+    // Concurrent payments and top-ups must neither lose nor create money
+    const unsigned int opening = 1000000;
+    FundAccount shared(opening);
+    std::atomic<unsigned long long> paid{0}, deposited{0};
+    std::vector<std::thread> payers;
+    for(unsigned int t = 0; t < 8; ++t)
+        payers.emplace_back([&shared, &paid, &deposited, t] {
+            uint32_t seed = t + 1;
+            for(int i = 0; i < 20000; ++i)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                unsigned int amount = 1 + (seed >> 8) % 400;
+                if(seed % 16 == 0)
+                {
+                    shared.Deposit(amount);
+                    deposited.fetch_add(amount, std::memory_order_relaxed);
+                }
+                else if(shared.TryPay(amount))
+                    paid.fetch_add(amount, std::memory_order_relaxed);
+            }
+        });
+    for(auto &payer : payers)
+        payer.join();
+    if(paid.load() + shared.Balance() != opening + deposited.load())
+    {
+        cout << "balance mismatch: paid " << paid.load() << ", left " << shared.Balance() << endl;
+        return 1;
+    }
+    cout << "balance consistent after " << paid.load() << " paid" << endl;
+    PrintPaymentRate();
+    PrintBatchTradeoff();
+
+    auto local = std::make_shared<LocalAccountDirectory>(
+        std::unordered_map<unsigned int, unsigned int>{{1, 1000}, {2, 250}}, std::chrono::microseconds(200));
+    CachingProxy<AccountDirectory> directory(local, 1024, std::chrono::seconds(1));
+    std::vector<std::thread> clients;
+    for(int i = 0; i < 4; ++i)
+        clients.emplace_back([&directory] { directory.Fetch(1); directory.Fetch(2); });
+    for(auto &client : clients)
+        client.join();
+    auto stats = directory.GetStats();
+    cout << "directory calls: " << local->Calls() << ", hits: " << stats.hits
+         << ", coalesced: " << stats.coalesced << endl;
+    PrintZipfianCache(0.8);
+    PrintZipfianCache(1.2);
+    AsyncLogger::Instance().Flush();
     
     return 0;
 }
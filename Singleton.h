@@ -0,0 +1,58 @@
+/* Reusable singleton holders.
+Singleton<T>::Instance() creates the object once, thread-safely, and afterwards costs a single
+acquire load. Construction goes through a mutex that is only taken while the instance does not
+exist yet. Call Singleton<T>::Init() during startup to construct eagerly, so the first call on a
+hot path does not pay for construction. Instances are never destroyed, which keeps them valid
+during static destruction.
+ThreadLocalSingleton<T>::Instance() gives every thread its own T, with no synchronization.
+
+T keeps its constructor private and befriends the holder:
+    friend class Singleton<T>;
+*/
+
+#ifndef SINGLETON_H
+#define SINGLETON_H
+
+#include <atomic>
+#include <mutex>
+
+template <typename T>
+class Singleton {
+ public:
+  static T *Instance() {
+    T *instance = s_instance.load(std::memory_order_acquire);
+    if (instance != nullptr) return instance;
+    return Create();
+  }
+
+  static void Init() { Instance(); }
+
+  Singleton() = delete;
+
+ private:
+  static T *Create() {
+    std::lock_guard<std::mutex> lock(s_lock);
+    T *instance = s_instance.load(std::memory_order_relaxed);
+    if (instance == nullptr) {
+      instance = new T();
+      s_instance.store(instance, std::memory_order_release);
+    }
+    return instance;
+  }
+
+  static inline std::atomic<T *> s_instance{nullptr};
+  static inline std::mutex s_lock;
+};
+
+template <typename T>
+class ThreadLocalSingleton {
+ public:
+  static T *Instance() {
+    thread_local T instance;
+    return &instance;
+  }
+
+  ThreadLocalSingleton() = delete;
+};
+
+#endif  // SINGLETON_H
@@ -8,43 +8,947 @@ Cons: Problem with tesability` - Have to deal with real data, and when these dat
 reference: http://www.vishalchovatiya.com/singleton-design-pattern-in-modern-cpp/                
 */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Epoch.h"
+#include "Singleton.h"
 
 
 //Interface class
 class DataBase {
     public:
-       virtual void CommondFunction() = 0;
+        using ScanCallback = std::function<void(const std::string& key, const std::string& value)>;
+
+        virtual ~DataBase() = default;
+        virtual void CommondFunction() = 0;
+        virtual bool Get(const std::string& key, std::string& value) = 0;
+        virtual void Put(const std::string& key, const std::string& value) = 0;
+        virtual bool Delete(const std::string& key) = 0;
+        // Visits keys in [begin, end) in key order; an empty end means no upper bound
+        virtual void Scan(const std::string& begin, const std::string& end, const ScanCallback& visit) = 0;
+};
+
+/* Embedded storage engine: an append-only log in a memory-mapped file, plus an in-memory hash
+index from each key to its latest record. A record is
+    [u32 checksum][u32 key size][u32 value size, or kTombstone for a delete][key][value]
+Opening the file replays the log up to the first record whose checksum doesn't match, which drops
+a write torn by a crash. Writes are durable after Sync() or once the store is closed.
+A background thread rewrites the log without dead records once they make up more than half of
+it. Reads keep going while it copies; writes only wait for the final swap. */
+class MappedDataBase : public DataBase {
+    public:
+        explicit MappedDataBase(const std::string& path)
+        :m_path(path) {
+            Recover();
+            m_compactor = std::thread(&MappedDataBase::RunCompaction, this);
+        }
+
+        ~MappedDataBase() {
+            {
+                std::lock_guard<std::mutex> lock(m_wakeLock);
+                m_stop = true;
+            }
+            m_wake.notify_one();
+            m_compactor.join();
+            ::msync(m_data, m_end, MS_SYNC);
+            ::munmap(m_data, m_capacity);
+            if(::ftruncate(m_fd, m_end) == 0)  // drop the preallocated tail
+                ::fsync(m_fd);
+            ::close(m_fd);
+        }
+
+        MappedDataBase(MappedDataBase const &) = delete;
+        MappedDataBase& operator = (MappedDataBase const &) = delete;
+
+        void CommondFunction() override {}
+
+        bool Get(const std::string& key, std::string& value) override {
+            std::shared_lock<std::shared_mutex> lock(m_lock);
+            auto it = m_index.find(key);
+            if(it == m_index.end())
+                return false;
+            RecordHeader header = HeaderAt(m_data, it->second.offset);
+            value.assign(m_data + it->second.offset + sizeof(RecordHeader) + header.keySize, header.valueSize);
+            return true;
+        }
+
+        void Put(const std::string& key, const std::string& value) override {
+            std::unique_lock<std::shared_mutex> lock(m_lock);
+            Location location = Append(key, value.data(), static_cast<uint32_t>(value.size()));
+            Apply(m_index, m_garbage, key, location, false);
+            MaybeRequestCompaction();
+        }
+
+        bool Delete(const std::string& key) override {
+            std::unique_lock<std::shared_mutex> lock(m_lock);
+            if(m_index.find(key) == m_index.end())
+                return false;
+            Location location = Append(key, nullptr, kTombstone);
+            Apply(m_index, m_garbage, key, location, true);
+            MaybeRequestCompaction();
+            return true;
+        }
+
+        void Scan(const std::string& begin, const std::string& end, const ScanCallback& visit) override {
+            std::vector<std::pair<std::string, std::string>> rows;
+            {
+                std::shared_lock<std::shared_mutex> lock(m_lock);
+                for(const auto& entry : m_index) {
+                    if(entry.first < begin || (!end.empty() && !(entry.first < end)))
+                        continue;
+                    RecordHeader header = HeaderAt(m_data, entry.second.offset);
+                    const char* value = m_data + entry.second.offset + sizeof(RecordHeader) + header.keySize;
+                    rows.emplace_back(entry.first, std::string(value, header.valueSize));
+                }
+            }
+            // visit without the lock held, so the callback may write to the store
+            std::sort(rows.begin(), rows.end());
+            for(const auto& row : rows)
+                visit(row.first, row.second);
+        }
+
+        void Sync() {
+            std::shared_lock<std::shared_mutex> lock(m_lock);
+            if(::msync(m_data, m_end, MS_SYNC) != 0)
+                throw std::system_error(errno, std::generic_category(), "msync " + m_path);
+        }
+
+        // Rewrites the log now instead of waiting for the background thread
+        void Compact() {
+            std::lock_guard<std::mutex> lock(m_compactLock);
+            CompactLocked();
+        }
+
+    private:
+        struct RecordHeader {
+            uint32_t checksum;
+            uint32_t keySize;
+            uint32_t valueSize;
+        };
+
+        struct Location {
+            uint64_t offset;
+            uint32_t size;  // whole record, header included
+        };
+
+        using Index = std::unordered_map<std::string, Location>;
+
+        static constexpr uint32_t kTombstone = UINT32_MAX;
+        static constexpr size_t kMinCapacity = size_t(1) << 20;
+        static constexpr size_t kMinGarbage = size_t(4) << 20;  // not worth compacting below this
+
+        static size_t RecordSize(uint32_t keySize, uint32_t valueSize) {
+            return sizeof(RecordHeader) + keySize + (valueSize == kTombstone ? 0 : valueSize);
+        }
+
+        static RecordHeader HeaderAt(const char* data, uint64_t offset) {
+            RecordHeader header;
+            std::memcpy(&header, data + offset, sizeof(header));
+            return header;
+        }
+
+        // FNV-1a over the sizes and the payload
+        static uint32_t Checksum(const RecordHeader& header, const char* payload, size_t size) {
+            uint32_t hash = 2166136261u;
+            auto mix = [&hash](const char* bytes, size_t n) {
+                for(size_t i = 0; i < n; ++i)
+                    hash = (hash ^ static_cast<unsigned char>(bytes[i])) * 16777619u;
+            };
+            mix(reinterpret_cast<const char*>(&header.keySize), sizeof(header.keySize) + sizeof(header.valueSize));
+            mix(payload, size);
+            return hash;
+        }
+
+        // Validates the record at offset against the first limit bytes of data
+        static bool ParseAt(const char* data, uint64_t offset, size_t limit, RecordHeader& header) {
+            if(limit - offset < sizeof(RecordHeader))
+                return false;
+            header = HeaderAt(data, offset);
+            size_t size = RecordSize(header.keySize, header.valueSize);
+            if(header.keySize > limit || size > limit - offset)
+                return false;
+            const char* payload = data + offset + sizeof(RecordHeader);
+            return Checksum(header, payload, size - sizeof(RecordHeader)) == header.checksum;
+        }
+
+        // Points key at its new record and counts the record it replaces as garbage
+        static void Apply(Index& index, size_t& garbage, const std::string& key, Location location, bool tombstone) {
+            auto it = index.find(key);
+            if(it != index.end())
+                garbage += it->second.size;
+            if(tombstone) {
+                garbage += location.size;
+                if(it != index.end())
+                    index.erase(it);
+            }
+            else if(it != index.end())
+                it->second = location;
+            else
+                index.emplace(key, location);
+        }
+
+        char* MapFile(int fd, size_t capacity) const {
+            if(::ftruncate(fd, capacity) != 0)
+                throw std::system_error(errno, std::generic_category(), "ftruncate " + m_path);
+            void* data = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if(data == MAP_FAILED)
+                throw std::system_error(errno, std::generic_category(), "mmap " + m_path);
+            return static_cast<char*>(data);
+        }
+
+        // Grows the mapping; on failure the old one stays in place and the store stays usable
+        void Map(size_t capacity) {
+            char* data = MapFile(m_fd, capacity);
+            if(m_data != nullptr)
+                ::munmap(m_data, m_capacity);
+            m_data = data;
+            m_capacity = capacity;
+        }
+
+        void Recover() {
+            m_fd = ::open(m_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            if(m_fd < 0)
+                throw std::system_error(errno, std::generic_category(), "open " + m_path);
+            struct stat info;
+            if(::fstat(m_fd, &info) != 0)
+                throw std::system_error(errno, std::generic_category(), "fstat " + m_path);
+            size_t fileSize = static_cast<size_t>(info.st_size);
+            Map(std::max(kMinCapacity, fileSize));
+            uint64_t offset = 0;
+            RecordHeader header;
+            while(ParseAt(m_data, offset, fileSize, header)) {
+                std::string key(m_data + offset + sizeof(RecordHeader), header.keySize);
+                uint32_t size = static_cast<uint32_t>(RecordSize(header.keySize, header.valueSize));
+                Apply(m_index, m_garbage, key, {offset, size}, header.valueSize == kTombstone);
+                offset += size;
+            }
+            m_end = offset;
+            // Clear whatever a crash left past the last good record, so a stale record there
+            // can never be mistaken for a valid one after later appends. Cutting the file back
+            // and extending it again zero-fills the tail without faulting in its pages.
+            if(fileSize > m_end) {
+                if(::ftruncate(m_fd, m_end) != 0 || ::ftruncate(m_fd, m_capacity) != 0)
+                    throw std::system_error(errno, std::generic_category(), "ftruncate " + m_path);
+            }
+        }
+
+        // Caller holds m_lock exclusively
+        Location Append(const std::string& key, const char* value, uint32_t valueSize) {
+            RecordHeader header{0, static_cast<uint32_t>(key.size()), valueSize};
+            size_t size = RecordSize(header.keySize, valueSize);
+            if(m_end + size > m_capacity) {
+                Map(std::max(m_capacity * 2, m_end + size));
+            }
+            char* record = m_data + m_end;
+            char* payload = record + sizeof(RecordHeader);
+            std::memcpy(payload, key.data(), key.size());
+            if(valueSize != kTombstone)
+                std::memcpy(payload + key.size(), value, valueSize);
+            header.checksum = Checksum(header, payload, size - sizeof(RecordHeader));
+            std::memcpy(record, &header, sizeof(header));
+            Location location{m_end, static_cast<uint32_t>(size)};
+            m_end += size;
+            return location;
+        }
+
+        void MaybeRequestCompaction() {
+            if(m_garbage < kMinGarbage || m_garbage * 2 < m_end)
+                return;
+            {
+                std::lock_guard<std::mutex> lock(m_wakeLock);
+                m_compactRequested = true;
+            }
+            m_wake.notify_one();
+        }
+
+        void RunCompaction() {
+            for(;;) {
+                {
+                    std::unique_lock<std::mutex> lock(m_wakeLock);
+                    m_wake.wait(lock, [this] { return m_stop || m_compactRequested; });
+                    if(m_stop)
+                        return;
+                    m_compactRequested = false;
+                }
+                try {
+                    std::lock_guard<std::mutex> lock(m_compactLock);
+                    CompactLocked();
+                }
+                catch(const std::system_error& error) {
+                    // The old log is untouched; try again on the next request
+                    std::cerr << "compaction failed: " << error.what() << "\n";
+                }
+            }
+        }
+
+        static void WriteAll(int fd, const char* data, size_t size) {
+            while(size > 0) {
+                ssize_t written = ::write(fd, data, size);
+                if(written < 0 && errno == EINTR)
+                    continue;
+                if(written < 0)
+                    throw std::system_error(errno, std::generic_category(), "write");
+                data += written;
+                size -= written;
+            }
+        }
+
+        /* 1. Snapshot the index (shared lock).
+           2. Copy the live records into a new file with pread: the log below the snapshot end
+              never changes, so no lock is needed while readers and writers go on.
+           3. Under the exclusive lock, append the records written meanwhile, then swap files. */
+        void CompactLocked() {
+            std::vector<std::pair<std::string, Location>> live;
+            uint64_t snapshotEnd;
+            {
+                std::shared_lock<std::shared_mutex> lock(m_lock);
+                live.assign(m_index.begin(), m_index.end());
+                snapshotEnd = m_end;
+            }
+            std::sort(live.begin(), live.end(),
+                      [](const auto& a, const auto& b) { return a.second.offset < b.second.offset; });
+
+            std::string tmpPath = m_path + ".compact";
+            int out = ::open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if(out < 0)
+                throw std::system_error(errno, std::generic_category(), "open " + tmpPath);
+            try {
+                Index index;
+                index.reserve(live.size());
+                size_t garbage = 0;
+                uint64_t outEnd = 0;
+                std::string buffer;
+                for(const auto& entry : live) {
+                    size_t at = buffer.size();
+                    buffer.resize(at + entry.second.size);
+                    if(::pread(m_fd, &buffer[at], entry.second.size, entry.second.offset) !=
+                       static_cast<ssize_t>(entry.second.size))
+                        throw std::system_error(errno, std::generic_category(), "pread " + m_path);
+                    index.emplace(entry.first, Location{outEnd, entry.second.size});
+                    outEnd += entry.second.size;
+                    if(buffer.size() >= kMinCapacity) {
+                        WriteAll(out, buffer.data(), buffer.size());
+                        buffer.clear();
+                    }
+                }
+                WriteAll(out, buffer.data(), buffer.size());
+                if(::fdatasync(out) != 0)
+                    throw std::system_error(errno, std::generic_category(), "fdatasync " + tmpPath);
+
+                std::unique_lock<std::shared_mutex> lock(m_lock);
+                uint64_t tailStart = outEnd;
+                for(uint64_t offset = snapshotEnd; offset < m_end; ) {
+                    RecordHeader header = HeaderAt(m_data, offset);
+                    std::string key(m_data + offset + sizeof(RecordHeader), header.keySize);
+                    uint32_t size = static_cast<uint32_t>(RecordSize(header.keySize, header.valueSize));
+                    Apply(index, garbage, key, {outEnd, size}, header.valueSize == kTombstone);
+                    offset += size;
+                    outEnd += size;
+                }
+                WriteAll(out, m_data + snapshotEnd, m_end - snapshotEnd);
+                if(outEnd != tailStart && ::fdatasync(out) != 0)
+                    throw std::system_error(errno, std::generic_category(), "fdatasync " + tmpPath);
+                // Map the new file before it replaces the old one, so a failure leaves the old
+                // file and mapping in use
+                size_t capacity = std::max(kMinCapacity, static_cast<size_t>(outEnd) * 2);
+                char* data = MapFile(out, capacity);
+                if(::rename(tmpPath.c_str(), m_path.c_str()) != 0) {
+                    int error = errno;
+                    ::munmap(data, capacity);
+                    throw std::system_error(error, std::generic_category(), "rename " + tmpPath);
+                }
+
+                ::msync(m_data, m_end, MS_SYNC);
+                ::munmap(m_data, m_capacity);
+                ::close(m_fd);
+                m_fd = out;
+                out = -1;
+                m_data = data;
+                m_capacity = capacity;
+                m_index = std::move(index);
+                m_garbage = garbage;
+                m_end = outEnd;
+                SyncDirectory();
+            }
+            catch(...) {
+                if(out >= 0) {
+                    ::close(out);
+                    ::unlink(tmpPath.c_str());
+                }
+                throw;
+            }
+        }
+
+        // Makes the rename itself durable
+        void SyncDirectory() {
+            size_t slash = m_path.rfind('/');
+            std::string dir = slash == std::string::npos ? "." : m_path.substr(0, slash + 1);
+            int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if(fd >= 0) {
+                ::fsync(fd);
+                ::close(fd);
+            }
+        }
+
+        std::string m_path;
+        int m_fd = -1;
+        char* m_data = nullptr;
+        size_t m_capacity = 0;
+        uint64_t m_end = 0;      // end of the last valid record
+        size_t m_garbage = 0;    // bytes of overwritten, deleted and tombstone records
+        Index m_index;
+        std::shared_mutex m_lock;  // guards everything above
+
+        std::mutex m_compactLock;  // one compaction at a time
+        std::mutex m_wakeLock;
+        std::condition_variable m_wake;
+        bool m_compactRequested = false;
+        bool m_stop = false;
+        std::thread m_compactor;
 };
+
+/* The one database of the process. Reads never take a lock: the data is kept as kShards
+open-addressing tables of atomic pointers to immutable key/value nodes, and a reader pins an
+Epoch::Guard, probes the published table and leaves. Writes go through a queue to a single writer
+thread, which applies a whole batch to the store and swaps in one new node per written key (a
+delete leaves a tombstone node), so a write costs O(1) however big its shard is. Only growth
+copies a table, and that copy shares the nodes. What a batch replaced is handed to Epoch::Retire
+as one bundle and freed once no reader can still see it.
+Every writing thread gets its own worker context (where its write completes) from a pool sized to
+the machine; threads beyond that get overflow contexts, allocated once and reused.
+A write the store rejects (e.g. the disk is full) is not applied and its caller gets the error. */
 class SingletonDataBase : public DataBase {
     public:
         SingletonDataBase(SingletonDataBase const &) = delete; 
-        SingletonDataBase& operator = (SingletonDataBase const &) = delete
+        SingletonDataBase& operator = (SingletonDataBase const &) = delete;
         
+        // Thread-safe; a single atomic load once the object exists
         static SingletonDataBase* Instance() {
-            if(m_instance == nullptr) {
-                std::cout << "Creating database object...\n"
-                m_instance = new SingletonDataBase();
-            }
-            std::cout << "database object is existing\n";
-            return m_instance;
+            return Singleton<SingletonDataBase>::Instance();
         }
         
-        void CommondFunction() {}
+        void CommondFunction() override {}
+
+        bool Get(const std::string& key, std::string& value) override {
+            size_t hash = std::hash<std::string>()(key);
+            Epoch::Guard guard;
+            const Table* table = m_shards[hash % kShards].load(std::memory_order_seq_cst);
+            const Node* node = table->Find(hash, key);
+            if(node == nullptr || !node->live)
+                return false;
+            value = node->value;
+            return true;
+        }
+
+        // Blocks until the write is applied and visible to readers
+        void Put(const std::string& key, const std::string& value) override {
+            Write(Request::PUT, key, value);
+        }
+
+        bool Delete(const std::string& key) override {
+            return Write(Request::DELETE, key, std::string());
+        }
+
+        void Scan(const std::string& begin, const std::string& end, const ScanCallback& visit) override {
+            std::vector<std::pair<std::string, std::string>> rows;
+            {
+                Epoch::Guard guard;
+                for(const auto& shard : m_shards) {
+                    const Table* table = shard.load(std::memory_order_seq_cst);
+                    for(size_t i = 0; i <= table->mask; ++i) {
+                        const Node* node = table->slots[i].load(std::memory_order_seq_cst);
+                        if(node != nullptr && node->live && !(node->key < begin) &&
+                           (end.empty() || node->key < end))
+                            rows.emplace_back(node->key, node->value);
+                    }
+                }
+            }
+            std::sort(rows.begin(), rows.end());
+            for(const auto& row : rows)
+                visit(row.first, row.second);
+        }
+
+        void Sync() { m_store.Sync(); }
+
     private:
-        static SingletonDataBase* m_instance;
-        SingletonDataBase() = default;
+        friend class Singleton<SingletonDataBase>;
+
+        static constexpr size_t kShards = 256;
+        static constexpr size_t kMaxBatch = 1024;
+        static constexpr size_t kMinCapacity = 16;  // slots per shard table
+
+        // Never changed once published; a write replaces the whole node
+        struct Node {
+            size_t hash;
+            std::string key;
+            std::string value;
+            bool live;  // false for a tombstone left by a delete
+        };
+
+        struct Table {
+            explicit Table(size_t capacity)
+            :mask(capacity - 1), slots(new std::atomic<const Node*>[capacity]) {
+                for(size_t i = 0; i < capacity; ++i)
+                    slots[i].store(nullptr, std::memory_order_relaxed);
+            }
+
+            // The slot holding key, or the empty slot where it would go
+            size_t Probe(size_t hash, const std::string& key) const {
+                for(size_t i = (hash / kShards) & mask;; i = (i + 1) & mask) {
+                    const Node* node = slots[i].load(std::memory_order_seq_cst);
+                    if(node == nullptr || (node->hash == hash && node->key == key))
+                        return i;
+                }
+            }
+
+            // Returns the node the probe matched; reloading its slot could pick up a node for
+            // another key that the writer has just put in a slot that was empty
+            const Node* Find(size_t hash, const std::string& key) const {
+                for(size_t i = (hash / kShards) & mask;; i = (i + 1) & mask) {
+                    const Node* node = slots[i].load(std::memory_order_seq_cst);
+                    if(node == nullptr || (node->hash == hash && node->key == key))
+                        return node;
+                }
+            }
+
+            size_t mask;
+            size_t used = 0;  // slots holding a node, tombstones included (writer only)
+            size_t live = 0;  // writer only
+            std::unique_ptr<std::atomic<const Node*>[]> slots;
+        };
+
+        // Completion of one thread's outstanding write
+        struct alignas(64) WorkerContext {
+            std::atomic<bool> inUse{false};
+            std::mutex lock;
+            std::condition_variable applied;
+            bool done = false;
+            bool result = false;
+            std::exception_ptr error;
+            WorkerContext* next = nullptr;  // overflow list link, set before publishing
+        };
+
+        struct Request {
+            enum Op { PUT, DELETE } op;
+            std::string key;
+            std::string value;
+            WorkerContext* context;
+        };
+
+        // Nodes and tables one batch unlinked, retired together
+        struct Garbage {
+            ~Garbage() {
+                for(const Node* node : nodes)
+                    delete node;
+                for(const Table* table : tables)
+                    delete table;
+            }
+            std::vector<const Node*> nodes;
+            std::vector<const Table*> tables;
+        };
+
+        SingletonDataBase(const std::string& path = "database.log")
+        :m_store(path),
+         m_contexts(std::max(64u, 4 * std::thread::hardware_concurrency())) {
+            std::cout << "Creating database object...\n";
+            for(auto& shard : m_shards)
+                shard.store(new Table(kMinCapacity), std::memory_order_relaxed);
+            m_store.Scan("", "", [this](const std::string& key, const std::string& value) {
+                Store(key, value, true);
+            });
+            m_writer = std::thread(&SingletonDataBase::RunWriter, this);
+        }
+
+        ~SingletonDataBase() {
+            {
+                std::lock_guard<std::mutex> lock(m_queueLock);
+                m_stop = true;
+            }
+            m_queued.notify_one();
+            m_writer.join();
+            for(auto& shard : m_shards) {
+                const Table* table = shard.load(std::memory_order_relaxed);
+                for(size_t i = 0; i <= table->mask; ++i)
+                    delete table->slots[i].load(std::memory_order_relaxed);
+                delete table;
+            }
+            for(WorkerContext* context = m_overflow.load(std::memory_order_relaxed); context; ) {
+                WorkerContext* next = context->next;
+                delete context;
+                context = next;
+            }
+        }
+
+        // Claimed by a thread on first use and handed back when the thread exits
+        WorkerContext& LocalContext() {
+            struct Lease {
+                const SingletonDataBase* owner = nullptr;
+                WorkerContext* context = nullptr;
+                ~Lease() {
+                    if(context)
+                        context->inUse.store(false, std::memory_order_release);
+                }
+            };
+            thread_local Lease lease;
+            if(lease.owner != this) {
+                lease.context = nullptr;
+                for(auto& context : m_contexts) {
+                    if(Claim(context)) {
+                        lease.context = &context;
+                        break;
+                    }
+                }
+                if(lease.context == nullptr)
+                    lease.context = OverflowContext();
+                lease.owner = this;
+            }
+            return *lease.context;
+        }
+
+        static bool Claim(WorkerContext& context) {
+            bool free = false;
+            return context.inUse.compare_exchange_strong(free, true, std::memory_order_acquire);
+        }
+
+        // For threads beyond the pool: a released overflow context, or a new one on the list
+        WorkerContext* OverflowContext() {
+            for(WorkerContext* context = m_overflow.load(std::memory_order_acquire); context;
+                context = context->next)
+                if(Claim(*context))
+                    return context;
+            WorkerContext* context = new WorkerContext();
+            context->inUse.store(true, std::memory_order_relaxed);
+            context->next = m_overflow.load(std::memory_order_relaxed);
+            while(!m_overflow.compare_exchange_weak(context->next, context, std::memory_order_release,
+                                                    std::memory_order_relaxed)) {}
+            return context;
+        }
+
+        bool Write(Request::Op op, const std::string& key, const std::string& value) {
+            WorkerContext& context = LocalContext();
+            {
+                std::lock_guard<std::mutex> lock(context.lock);
+                context.done = false;
+            }
+            bool wake;
+            {
+                std::lock_guard<std::mutex> lock(m_queueLock);
+                m_queue.push_back({op, key, value, &context});
+                wake = m_queue.size() == 1;
+            }
+            if(wake)
+                m_queued.notify_one();
+            std::unique_lock<std::mutex> lock(context.lock);
+            context.applied.wait(lock, [&context] { return context.done; });
+            if(context.error)
+                std::rethrow_exception(std::exchange(context.error, nullptr));
+            return context.result;
+        }
+
+        void RunWriter() {
+            std::vector<Request> batch;
+            for(;;) {
+                {
+                    std::unique_lock<std::mutex> lock(m_queueLock);
+                    m_queued.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+                    if(m_queue.empty())
+                        return;
+                    size_t take = std::min(m_queue.size(), kMaxBatch);
+                    batch.assign(std::make_move_iterator(m_queue.begin()),
+                                 std::make_move_iterator(m_queue.begin() + take));
+                    m_queue.erase(m_queue.begin(), m_queue.begin() + take);
+                }
+                ApplyBatch(batch);
+                batch.clear();
+            }
+        }
+
+        void ApplyBatch(std::vector<Request>& batch) {
+            std::vector<char> results(batch.size());
+            std::vector<std::exception_ptr> errors(batch.size());
+            for(size_t i = 0; i < batch.size(); ++i) {
+                Request& request = batch[i];
+                // The store goes first, so a write it rejects never becomes visible
+                try {
+                    if(request.op == Request::PUT) {
+                        m_store.Put(request.key, request.value);
+                        Store(request.key, std::move(request.value), true);
+                        results[i] = true;
+                    }
+                    else if(IsLive(request.key)) {
+                        m_store.Delete(request.key);
+                        results[i] = Store(request.key, std::string(), false);
+                    }
+                }
+                catch(...) {
+                    errors[i] = std::current_exception();
+                }
+            }
+            // Everything replaced by this batch is unlinked by now
+            if(!m_garbage->nodes.empty() || !m_garbage->tables.empty())
+                Epoch::Retire(m_garbage.release());
+            m_garbage = std::make_unique<Garbage>();
+            for(size_t i = 0; i < batch.size(); ++i) {
+                WorkerContext& context = *batch[i].context;
+                {
+                    std::lock_guard<std::mutex> lock(context.lock);
+                    context.done = true;
+                    context.result = results[i];
+                    context.error = std::move(errors[i]);
+                }
+                context.applied.notify_one();
+            }
+        }
+
+        // Writer thread only
+        bool IsLive(const std::string& key) const {
+            size_t hash = std::hash<std::string>()(key);
+            const Node* node = m_shards[hash % kShards].load(std::memory_order_relaxed)->Find(hash, key);
+            return node != nullptr && node->live;
+        }
+
+        /* Publishes a new node for key (a tombstone when live is false) and retires the one it
+           replaces. Returns whether the key was live before. Writer thread only. */
+        bool Store(const std::string& key, std::string value, bool live) {
+            size_t hash = std::hash<std::string>()(key);
+            std::atomic<const Table*>& shard = m_shards[hash % kShards];
+            const Table* table = shard.load(std::memory_order_relaxed);
+            size_t slot = table->Probe(hash, key);
+            const Node* old = table->slots[slot].load(std::memory_order_relaxed);
+            bool wasLive = old != nullptr && old->live;
+            if(old == nullptr && !live)
+                return false;  // nothing to delete
+            if(old == nullptr && 2 * (table->used + 1) > table->mask + 1) {
+                table = Rebuild(shard);
+                slot = table->Probe(hash, key);
+            }
+            Table& target = const_cast<Table&>(*table);
+            const Node* node = new Node{hash, key, std::move(value), live};
+            target.slots[slot].exchange(node, std::memory_order_seq_cst);
+            if(old != nullptr)
+                m_garbage->nodes.push_back(old);
+            else
+                ++target.used;
+            target.live += size_t(live) - size_t(wasLive);
+            return wasLive;
+        }
+
+        // Copies the live nodes into a table with room to grow; tombstones are dropped
+        const Table* Rebuild(std::atomic<const Table*>& shard) {
+            const Table* old = shard.load(std::memory_order_relaxed);
+            size_t capacity = kMinCapacity;
+            while(capacity < 4 * (old->live + 1))
+                capacity *= 2;
+            Table* table = new Table(capacity);
+            for(size_t i = 0; i <= old->mask; ++i) {
+                const Node* node = old->slots[i].load(std::memory_order_relaxed);
+                if(node == nullptr)
+                    continue;
+                if(!node->live) {
+                    m_garbage->nodes.push_back(node);
+                    continue;
+                }
+                table->slots[table->Probe(node->hash, node->key)].store(node, std::memory_order_relaxed);
+                ++table->used;
+                ++table->live;
+            }
+            shard.exchange(table, std::memory_order_seq_cst);
+            m_garbage->tables.push_back(old);
+            return table;
+        }
+
+        MappedDataBase m_store;  // written by the writer thread only
+        std::atomic<const Table*> m_shards[kShards];
+        std::vector<WorkerContext> m_contexts;
+        std::atomic<WorkerContext*> m_overflow{nullptr};  // push-only list, freed with the database
+
+        std::mutex m_queueLock;
+        std::condition_variable m_queued;
+        std::vector<Request> m_queue;
+        bool m_stop = false;
+        std::unique_ptr<Garbage> m_garbage = std::make_unique<Garbage>();  // writer thread only
+        std::thread m_writer;
 };
-SingletonDataBase* SingletonDataBase::m_instance = nullptr;
 
+//In-memory implementation of the same API, for unit tests
 class DummyDataBase : public DataBase {
     public:
         DummyDataBase() = default;
-        void CommondFunction() {};
+        void CommondFunction() override {};
+
+        bool Get(const std::string& key, std::string& value) override {
+            std::shared_lock<std::shared_mutex> lock(m_lock);
+            auto it = m_rows.find(key);
+            if(it == m_rows.end())
+                return false;
+            value = it->second;
+            return true;
+        }
+
+        void Put(const std::string& key, const std::string& value) override {
+            std::unique_lock<std::shared_mutex> lock(m_lock);
+            m_rows[key] = value;
+        }
+
+        bool Delete(const std::string& key) override {
+            std::unique_lock<std::shared_mutex> lock(m_lock);
+            return m_rows.erase(key) > 0;
+        }
+
+        void Scan(const std::string& begin, const std::string& end, const ScanCallback& visit) override {
+            std::vector<std::pair<std::string, std::string>> rows;
+            {
+                std::shared_lock<std::shared_mutex> lock(m_lock);
+                auto last = end.empty() ? m_rows.end() : m_rows.lower_bound(end);
+                for(auto it = m_rows.lower_bound(begin); it != last; ++it)
+                    rows.emplace_back(*it);
+            }
+            for(const auto& row : rows)
+                visit(row.first, row.second);
+        }
+
+    private:
+        std::shared_mutex m_lock;
+        std::map<std::string, std::string> m_rows;
 };
 
+// Measurements printed by main(); sizes are kept small so the demo stays quick
+template <typename Body>
+double NanosPerOp(size_t ops, Body&& body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ops;
+}
+
+// Runs body(thread, ops) on `threads` threads that share `total` operations
+template <typename Body>
+double NanosPerOpOnThreads(unsigned threads, size_t total, Body body) {
+    return NanosPerOp(total, [&] {
+        std::vector<std::thread> workers;
+        for(unsigned t = 0; t < threads; ++t)
+            workers.emplace_back([&body, t, threads, total] { body(t, total / threads); });
+        for(auto& worker : workers)
+            worker.join();
+    });
+}
+
+// 10M Instance() calls split over 1 to 64 threads, after the instance exists
+void PrintInstanceRate() {
+    std::cout << "M Instance() calls/s:";
+    for(unsigned threads = 1; threads <= 64; threads *= 2) {
+        std::atomic<uintptr_t> sink{0};
+        double ns = NanosPerOpOnThreads(threads, 10000000, [&sink](unsigned, size_t calls) {
+            uintptr_t seen = 0;
+            for(size_t i = 0; i < calls; ++i)
+                seen ^= reinterpret_cast<uintptr_t>(SingletonDataBase::Instance()) + i;
+            sink.fetch_xor(seen, std::memory_order_relaxed);
+        });
+        std::cout << " " << threads << "T " << 1e3 / ns;
+    }
+    std::cout << "\n";
+}
+
+/* Sequential and random Put/Get on the mapped store with 100k keys and 100-byte values, then the
+time to reopen it, which replays the log. The file is created in the working directory and
+removed afterwards. */
+void PrintStoreRates() {
+    const char* path = "bench_store.log";
+    const size_t keys = 100000;
+    ::unlink(path);
+    std::vector<std::string> names(keys);
+    for(size_t i = 0; i < keys; ++i) {
+        char name[16];
+        std::snprintf(name, sizeof(name), "key%08zu", i);
+        names[i] = name;
+    }
+    std::vector<std::string> shuffled = names;
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(5));
+    const std::string value(100, 'v');
+    std::string out;
+    double seqPut, randPut, seqGet, randGet, recover;
+    {
+        MappedDataBase store(path);
+        seqPut = NanosPerOp(keys, [&] { for(const auto& key : names) store.Put(key, value); });
+        randPut = NanosPerOp(keys, [&] { for(const auto& key : shuffled) store.Put(key, value); });
+        store.Compact();  // half the log is now dead; don't let the background rewrite share the reads' time
+        seqGet = NanosPerOp(keys, [&] { for(const auto& key : names) store.Get(key, out); });
+        randGet = NanosPerOp(keys, [&] { for(const auto& key : shuffled) store.Get(key, out); });
+    }
+    recover = NanosPerOp(1, [&] { MappedDataBase reopened(path); });
+    ::unlink(path);
+    std::cout << "M ops/s with " << keys << " keys: sequential put " << 1e3 / seqPut << ", random put "
+              << 1e3 / randPut << ", sequential get " << 1e3 / seqGet << ", random get " << 1e3 / randGet
+              << "; reopened in " << recover / 1e6 << " ms\n";
+}
+
+// Mixed Get/Put through the singleton over 1000 preloaded keys, 20k operations per row split
+// over 1 to 64 threads; writePercent of them are writes
+void PrintMixedRates(SingletonDataBase* db, unsigned writePercent) {
+    const size_t keys = 1000;
+    std::vector<std::string> names(keys);
+    for(size_t i = 0; i < keys; ++i) {
+        names[i] = "mix:" + std::to_string(i);
+        db->Put(names[i], "0");
+    }
+    std::cout << 100 - writePercent << "/" << writePercent << " read/write, k ops/s:";
+    for(unsigned threads = 1; threads <= 64; threads *= 2) {
+        double ns = NanosPerOpOnThreads(threads, 20000, [&](unsigned t, size_t ops) {
+            std::mt19937 rng(t);
+            std::string value;
+            for(size_t i = 0; i < ops; ++i) {
+                const std::string& key = names[rng() % keys];
+                if(rng() % 100 < writePercent)
+                    db->Put(key, "1");
+                else
+                    db->Get(key, value);
+            }
+        });
+        std::cout << " " << threads << "T " << 1e6 / ns;
+    }
+    std::cout << "\n";
+}
+
 int main() {
     
+    Singleton<SingletonDataBase>::Init(); // construct at startup, not on first use
     SingletonDataBase* db = SingletonDataBase::Instance();
+    db->Put("user:1", "alice");
+    db->Put("user:2", "bob");
+    db->Delete("user:1");
+    db->Scan("user:", "user;", [](const std::string& key, const std::string& value) {
+        std::cout << key << " = " << value << "\n";
+    });
+    db->Sync();
+
+    PrintInstanceRate();
+    PrintStoreRates();
+    PrintMixedRates(db, 5);
+    PrintMixedRates(db, 50);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,283 @@
+/* Strategy is a behavioral design pattern that lets you define a family of algorithms, put each of
+them into a separate class, and make their objects interchangeable.
+Pros: swap algorithms at runtime, isolate the algorithm from the code that uses it.
+Cons: the classic form costs a virtual call per use, which dominates when the algorithm is a few
+      instructions applied to millions of items (pricing quotes, approving payments, scoring enemies).
+
+Here a strategy is chosen once, at runtime, for a whole batch: from a config value (StrategyTable)
+and from the CPU features (scalar, SSE4.2 or AVX2 build of the same loop). Each concrete strategy
+is a small copyable function object; BatchStrategy stores it together with a pointer to a loop
+instantiated for exactly that type, so the only indirect call is the one per batch and the
+strategy body is inlined (and vectorized) inside the loop.
+Useful link: https://refactoring.guru/design-patterns/strategy
+*/
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define STRATEGY_X86 1
+#else
+#define STRATEGY_X86 0
+#endif
+
+enum class eISA {
+    SCALAR,
+    SSE42,
+    AVX2
+};
+
+inline const char* IsaName(eISA isa) {
+    switch(isa) {
+        case eISA::AVX2: return "avx2";
+        case eISA::SSE42: return "sse4.2";
+        default: return "scalar";
+    }
+}
+
+// Best instruction set of the running CPU, detected once
+inline eISA DetectIsa() {
+#if STRATEGY_X86
+    static const eISA isa = __builtin_cpu_supports("avx2") ? eISA::AVX2
+                          : __builtin_cpu_supports("sse4.2") ? eISA::SSE42
+                          : eISA::SCALAR;
+    return isa;
+#else
+    return eISA::SCALAR;
+#endif
+}
+
+/* The same batch loop compiled three times. The strategy's operator() is inlined into each copy,
+so the compiler can vectorize it with the instructions that copy is allowed to use. */
+template <typename Policy, typename In, typename Out>
+void BatchScalar(const void* policy, const In* in, Out* out, size_t count) {
+    const Policy& apply = *static_cast<const Policy*>(policy);
+    for(size_t i = 0; i < count; ++i)
+        out[i] = apply(in[i]);
+}
+
+#if STRATEGY_X86
+template <typename Policy, typename In, typename Out>
+__attribute__((target("sse4.2")))
+void BatchSse42(const void* policy, const In* in, Out* out, size_t count) {
+    const Policy& apply = *static_cast<const Policy*>(policy);
+    for(size_t i = 0; i < count; ++i)
+        out[i] = apply(in[i]);
+}
+
+template <typename Policy, typename In, typename Out>
+__attribute__((target("avx2")))
+void BatchAvx2(const void* policy, const In* in, Out* out, size_t count) {
+    const Policy& apply = *static_cast<const Policy*>(policy);
+    for(size_t i = 0; i < count; ++i)
+        out[i] = apply(in[i]);
+}
+#endif
+
+//A strategy bound to a batch loop for its exact type
+template <typename In, typename Out>
+class BatchStrategy {
+    public:
+        static constexpr size_t kMaxPolicySize = 64;
+
+        template <typename Policy>
+        static BatchStrategy Make(const Policy& policy, eISA isa = DetectIsa()) {
+            static_assert(std::is_trivially_copyable<Policy>::value, "strategies are copied byte-wise");
+            static_assert(sizeof(Policy) <= kMaxPolicySize && alignof(Policy) <= alignof(std::max_align_t),
+                          "strategy too large to store inline");
+            BatchStrategy strategy;
+            std::memcpy(strategy.m_policy, &policy, sizeof(Policy));
+            strategy.m_isa = eISA::SCALAR;
+            strategy.m_batch = &BatchScalar<Policy, In, Out>;
+#if STRATEGY_X86
+            if(isa == eISA::AVX2) {
+                strategy.m_isa = eISA::AVX2;
+                strategy.m_batch = &BatchAvx2<Policy, In, Out>;
+            }
+            else if(isa == eISA::SSE42) {
+                strategy.m_isa = eISA::SSE42;
+                strategy.m_batch = &BatchSse42<Policy, In, Out>;
+            }
+#endif
+            return strategy;
+        }
+
+        void Run(const In* in, Out* out, size_t count) const {
+            m_batch(m_policy, in, out, count);
+        }
+
+        eISA Isa() const { return m_isa; }
+
+    private:
+        using Batch = void (*)(const void*, const In*, Out*, size_t);
+
+        BatchStrategy() = default;
+
+        alignas(std::max_align_t) unsigned char m_policy[kMaxPolicySize];
+        Batch m_batch = nullptr;
+        eISA m_isa = eISA::SCALAR;
+};
+
+//Strategies selectable by name, e.g. from a config file
+template <typename In, typename Out>
+class StrategyTable {
+    public:
+        template <typename Policy>
+        StrategyTable& Add(const std::string& name, const Policy& policy) {
+            m_entries.emplace_back(name, BatchStrategy<In, Out>::Make(policy));
+            return *this;
+        }
+
+        // Throws on an unknown name so a typo in the config fails at startup
+        const BatchStrategy<In, Out>& Pick(const std::string& name) const {
+            for(const auto& entry : m_entries)
+                if(entry.first == name)
+                    return entry.second;
+            throw std::invalid_argument("unknown strategy: " + name);
+        }
+
+    private:
+        std::vector<std::pair<std::string, BatchStrategy<In, Out>>> m_entries;
+};
+
+//Pricing for IFInvestment::Buy
+struct Quote {
+    double bid;
+    double ask;
+};
+
+struct MidPrice {
+    double operator()(const Quote& q) const { return (q.bid + q.ask) * 0.5; }
+};
+
+struct CrossSpread {
+    double fee;
+    double operator()(const Quote& q) const { return q.ask + fee; }
+};
+
+//Approval policy for ProxyCheck
+struct PaymentRequest {
+    uint32_t balance;
+    uint32_t amount;
+};
+
+struct StrictFunds {
+    uint8_t operator()(const PaymentRequest& p) const { return p.balance >= p.amount; }
+};
+
+struct Overdraft {
+    uint32_t limit;
+    uint8_t operator()(const PaymentRequest& p) const {
+        return uint64_t(p.amount) <= uint64_t(p.balance) + limit;
+    }
+};
+
+//Enemy selection for GameApp: higher score is attacked first
+struct Threat {
+    float distance;
+    float health;
+};
+
+struct NearestFirst {
+    float operator()(const Threat& t) const { return -t.distance; }
+};
+
+struct WeakestFirst {
+    float operator()(const Threat& t) const { return -t.health; }
+};
+
+//The classic form, kept for comparison
+class PricingStrategy {
+    public:
+        virtual ~PricingStrategy() = default;
+        virtual double Price(const Quote& q) const = 0;
+};
+
+class VirtualMidPrice : public PricingStrategy {
+    public:
+        double Price(const Quote& q) const override { return MidPrice()(q); }
+};
+
+class VirtualCrossSpread : public PricingStrategy {
+    public:
+        explicit VirtualCrossSpread(double fee) : m_fee(fee) {}
+        double Price(const Quote& q) const override { return CrossSpread{m_fee}(q); }
+    private:
+        double m_fee;
+};
+
+template <typename Body>
+double NanosPerItem(size_t count, Body&& body) {
+    body();  // warm up caches and branch predictors
+    auto start = std::chrono::steady_clock::now();
+    body();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / count;
+}
+
+int main(int argc, char* argv[])
+{
+    // The config value picks the algorithm, the CPU picks the instruction set
+    std::string pricing = argc > 1 ? argv[1] : "mid";
+
+    StrategyTable<Quote, double> prices;
+    prices.Add("mid", MidPrice()).Add("cross", CrossSpread{0.01});
+    const auto& price = prices.Pick(pricing);
+    std::cout << "pricing: " << pricing << " (" << IsaName(price.Isa()) << ")\n";
+
+    const size_t count = 1 << 20;
+    std::vector<Quote> quotes(count);
+    for(size_t i = 0; i < count; ++i)
+        quotes[i] = {100.0 + i % 50, 100.5 + i % 50};
+    std::vector<double> out(count);
+
+    std::unique_ptr<PricingStrategy> virtualPrice;
+    std::function<double(const Quote&)> functionPrice;
+    if(pricing == "cross") {
+        virtualPrice = std::make_unique<VirtualCrossSpread>(0.01);
+        functionPrice = CrossSpread{0.01};
+    }
+    else {
+        virtualPrice = std::make_unique<VirtualMidPrice>();
+        functionPrice = MidPrice();
+    }
+
+    double checksum = 0;
+    double perVirtual = NanosPerItem(count, [&] {
+        for(size_t i = 0; i < count; ++i)
+            out[i] = virtualPrice->Price(quotes[i]);
+    });
+    checksum += out[count - 1];
+    double perFunction = NanosPerItem(count, [&] {
+        for(size_t i = 0; i < count; ++i)
+            out[i] = functionPrice(quotes[i]);
+    });
+    checksum += out[count - 1];
+    double perBatch = NanosPerItem(count, [&] { price.Run(quotes.data(), out.data(), count); });
+    checksum += out[count - 1];
+    std::cout << "ns per quote: virtual " << perVirtual << ", std::function " << perFunction
+              << ", batch " << perBatch << " (checksum " << checksum << ")\n";
+
+    PaymentRequest payments[] = {{1000, 500}, {1000, 50000}, {100, 120}};
+    uint8_t approved[3];
+    BatchStrategy<PaymentRequest, uint8_t>::Make(Overdraft{50}).Run(payments, approved, 3);
+    std::cout << "approved with overdraft: " << int(approved[0]) << int(approved[1]) << int(approved[2]) << "\n";
+
+    Threat threats[] = {{12.0f, 40.0f}, {3.5f, 90.0f}};
+    float score[2];
+    BatchStrategy<Threat, float>::Make(NearestFirst()).Run(threats, score, 2);
+    std::cout << "attack enemy " << (score[0] > score[1] ? 0 : 1) << " first\n";
+
+    return 0;
+}